@@ -0,0 +1,42 @@
+#ifndef __EXT2FS_ARENA_H__
+#define __EXT2FS_ARENA_H__
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+/* Bump allocator for data that dies with one directory block. release() drops
+   everything at once and rewinds to the owned initial buffer, so steady-state
+   scanning never reaches malloc. */
+class ScanArena {
+public:
+    explicit ScanArena(size_t initial_bytes = 8192)
+        : storage(initial_bytes), resource(storage.data(), storage.size()) {}
+
+    std::pmr::memory_resource* get() { return &resource; }
+    void release() { resource.release(); }
+
+private:
+    std::vector<std::byte> storage;
+    std::pmr::monotonic_buffer_resource resource;
+};
+
+/* One ScanArena per nesting level. A directory block's containers must outlive
+   the recursion into its children, so each depth owns its own arena and only the
+   next block at the same depth may reset it. */
+class ScanArenaStack {
+public:
+    std::pmr::memory_resource* enter(size_t depth) {
+        while (levels.size() <= depth) {
+            levels.push_back(std::make_unique<ScanArena>());
+        }
+        levels[depth]->release();
+        return levels[depth]->get();
+    }
+
+private:
+    std::vector<std::unique_ptr<ScanArena>> levels;
+};
+
+#endif
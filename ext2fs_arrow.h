@@ -0,0 +1,331 @@
+#ifndef __EXT2FS_ARROW_H__
+#define __EXT2FS_ARROW_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Minimal back-to-front FlatBuffers builder, enough for the Arrow IPC metadata
+   tables. Offsets returned by the builder count bytes from the end of the
+   buffer, as in the reference implementation. Bytes are kept reversed and
+   flipped once in finish(). */
+class FlatBuilder {
+public:
+    uint32_t size() const { return static_cast<uint32_t>(rev.size()); }
+
+    void align(size_t bytes_after, size_t alignment) {
+        if (alignment > min_align) min_align = alignment;
+        while ((rev.size() + bytes_after) % alignment) rev.push_back(0);
+    }
+
+    template <typename T>
+    void pushScalar(T v) {
+        align(sizeof(T), sizeof(T));
+        pushRaw(&v, sizeof(T));
+    }
+
+    void pushUOffset(uint32_t target) {
+        align(4, 4);
+        uint32_t rel = size() + 4 - target;
+        pushRaw(&rel, 4);
+    }
+
+    uint32_t createString(const std::string& s) {
+        align(s.size() + 1, 4);
+        rev.push_back(0);
+        for (size_t i = s.size(); i-- > 0;) rev.push_back(static_cast<uint8_t>(s[i]));
+        uint32_t len = static_cast<uint32_t>(s.size());
+        pushRaw(&len, 4);
+        return size();
+    }
+
+    uint32_t createOffsetVector(const std::vector<uint32_t>& offsets) {
+        align(offsets.size() * 4, 4);
+        for (size_t i = offsets.size(); i-- > 0;) pushUOffset(offsets[i]);
+        uint32_t n = static_cast<uint32_t>(offsets.size());
+        pushRaw(&n, 4);
+        return size();
+    }
+
+    /* Structs are passed as raw little-endian bytes of struct_size each. */
+    uint32_t createStructVector(const std::vector<uint8_t>& bytes, size_t struct_size, size_t alignment) {
+        align(bytes.size(), alignment);
+        align(bytes.size(), 4);
+        for (size_t i = bytes.size(); i-- > 0;) rev.push_back(bytes[i]);
+        uint32_t n = static_cast<uint32_t>(bytes.size() / struct_size);
+        pushRaw(&n, 4);
+        return size();
+    }
+
+    void startTable() {
+        fields.clear();
+        table_start = size();
+    }
+
+    template <typename T>
+    void addScalar(uint16_t slot, T v) {
+        pushScalar(v);
+        fields.push_back({slot, size()});
+    }
+
+    void addOffset(uint16_t slot, uint32_t target) {
+        pushUOffset(target);
+        fields.push_back({slot, size()});
+    }
+
+    uint32_t endTable() {
+        int32_t placeholder = 0;
+        pushScalar(placeholder);
+        uint32_t table_off = size();
+
+        uint16_t slots = 0;
+        for (const auto& f : fields) slots = std::max<uint16_t>(slots, static_cast<uint16_t>(f.slot + 1));
+        std::vector<uint16_t> entries(slots, 0);
+        for (const auto& f : fields) entries[f.slot] = static_cast<uint16_t>(table_off - f.offset);
+        for (size_t i = entries.size(); i-- > 0;) pushScalar(entries[i]);
+        pushScalar(static_cast<uint16_t>(table_off - table_start));
+        pushScalar(static_cast<uint16_t>(4 + 2 * slots));
+        uint32_t vtable_off = size();
+
+        int32_t soffset = static_cast<int32_t>(vtable_off - table_off);
+        for (int k = 0; k < 4; k++) rev[table_off - 1 - k] = static_cast<uint8_t>((soffset >> (8 * k)) & 0xFF);
+        return table_off;
+    }
+
+    std::vector<uint8_t> finish(uint32_t root) {
+        align(4, min_align);
+        pushUOffset(root);
+        return std::vector<uint8_t>(rev.rbegin(), rev.rend());
+    }
+
+private:
+    struct FieldSlot {
+        uint16_t slot;
+        uint32_t offset;
+    };
+    std::vector<uint8_t> rev;
+    std::vector<FieldSlot> fields;
+    uint32_t table_start = 0;
+    size_t min_align = 1;
+
+    void pushRaw(const void* p, size_t n) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(p);
+        for (size_t i = n; i-- > 0;) rev.push_back(bytes[i]);
+    }
+};
+
+/* Writes one table as an Arrow IPC file (schema, one record batch, footer).
+   Supported column types: uint16, uint32, bool and binary, all non-null. */
+class ArrowTableWriter {
+public:
+    explicit ArrowTableWriter(size_t rows) : rows(rows) {}
+
+    void addUInt32(const std::string& name, const std::vector<uint32_t>& values) {
+        Column c{name, Kind::UInt32, {}};
+        c.buffers.push_back(bytesOf(values.data(), values.size() * 4));
+        columns.push_back(std::move(c));
+    }
+
+    void addUInt16(const std::string& name, const std::vector<uint16_t>& values) {
+        Column c{name, Kind::UInt16, {}};
+        c.buffers.push_back(bytesOf(values.data(), values.size() * 2));
+        columns.push_back(std::move(c));
+    }
+
+    void addBool(const std::string& name, const std::vector<bool>& values) {
+        std::vector<uint8_t> bits((values.size() + 7) / 8, 0);
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i]) bits[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        }
+        Column c{name, Kind::Bool, {}};
+        c.buffers.push_back(std::move(bits));
+        columns.push_back(std::move(c));
+    }
+
+    // raw bytes, e.g. names carved from directory slack
+    void addBinary(const std::string& name, const std::vector<std::string>& values) {
+        addVariable(name, Kind::Binary, values);
+    }
+
+    void write(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out) throw std::runtime_error("Failed to open for writing: " + filename);
+        std::vector<uint8_t> file;
+        const char magic[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+        file.insert(file.end(), magic, magic + 8);
+
+        appendMessage(file, schemaMessage(), {});
+
+        std::vector<uint8_t> body;
+        std::vector<uint8_t> buffer_structs;
+        for (const auto& c : columns) {
+            putBufferStruct(buffer_structs, body.size(), 0); // validity: absent, no nulls
+            for (const auto& b : c.buffers) {
+                putBufferStruct(buffer_structs, body.size(), b.size());
+                body.insert(body.end(), b.begin(), b.end());
+                while (body.size() % 8) body.push_back(0);
+            }
+        }
+        uint64_t batch_offset = file.size();
+        uint32_t batch_meta = appendMessage(file, batchMessage(buffer_structs, body.size()), body);
+
+        const uint8_t eos[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+        file.insert(file.end(), eos, eos + 8);
+
+        std::vector<uint8_t> footer = footerBuffer(batch_offset, batch_meta, body.size());
+        file.insert(file.end(), footer.begin(), footer.end());
+        putLE(file, static_cast<uint32_t>(footer.size()), 4);
+        file.insert(file.end(), magic, magic + 6);
+
+        out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+        if (!out) throw std::runtime_error("Failed to write " + filename);
+    }
+
+private:
+    enum class Kind { UInt16, UInt32, Bool, Binary };
+    struct Column {
+        std::string name;
+        Kind kind;
+        std::vector<std::vector<uint8_t>> buffers;
+    };
+
+    void addVariable(const std::string& name, Kind kind, const std::vector<std::string>& values) {
+        std::vector<int32_t> offsets(values.size() + 1, 0);
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i < values.size(); i++) {
+            data.insert(data.end(), values[i].begin(), values[i].end());
+            offsets[i + 1] = static_cast<int32_t>(data.size());
+        }
+        Column c{name, kind, {}};
+        c.buffers.push_back(bytesOf(offsets.data(), offsets.size() * 4));
+        c.buffers.push_back(std::move(data));
+        columns.push_back(std::move(c));
+    }
+
+    // Arrow format enums (Schema.fbs / Message.fbs)
+    static constexpr int16_t kMetadataV5 = 4;
+    static constexpr uint8_t kHeaderSchema = 1;
+    static constexpr uint8_t kHeaderRecordBatch = 3;
+    static constexpr uint8_t kTypeInt = 2;
+    static constexpr uint8_t kTypeBinary = 4;
+    static constexpr uint8_t kTypeBool = 6;
+
+    size_t rows;
+    std::vector<Column> columns;
+
+    static std::vector<uint8_t> bytesOf(const void* p, size_t n) {
+        const uint8_t* b = static_cast<const uint8_t*>(p);
+        return std::vector<uint8_t>(b, b + n);
+    }
+
+    static void putLE(std::vector<uint8_t>& out, uint64_t v, int bytes) {
+        for (int i = 0; i < bytes; i++) out.push_back(static_cast<uint8_t>((v >> (8 * i)) & 0xFF));
+    }
+
+    static void putBufferStruct(std::vector<uint8_t>& out, uint64_t offset, uint64_t length) {
+        putLE(out, offset, 8);
+        putLE(out, length, 8);
+    }
+
+    uint32_t buildSchema(FlatBuilder& fb) const {
+        std::vector<uint32_t> fields;
+        for (const auto& c : columns) {
+            uint32_t type_off;
+            uint8_t type_tag;
+            fb.startTable();
+            if (c.kind == Kind::UInt16 || c.kind == Kind::UInt32) {
+                fb.addScalar<int32_t>(0, c.kind == Kind::UInt16 ? 16 : 32); // bitWidth
+                fb.addScalar<uint8_t>(1, 0);                                 // is_signed
+                type_tag = kTypeInt;
+            } else {
+                type_tag = c.kind == Kind::Bool ? kTypeBool : kTypeBinary;
+            }
+            type_off = fb.endTable();
+            uint32_t name_off = fb.createString(c.name);
+            uint32_t children_off = fb.createOffsetVector({});
+
+            fb.startTable();
+            fb.addOffset(0, name_off);
+            fb.addScalar<uint8_t>(1, 1);        // nullable
+            fb.addScalar<uint8_t>(2, type_tag); // type_type
+            fb.addOffset(3, type_off);
+            fb.addOffset(5, children_off);
+            fields.push_back(fb.endTable());
+        }
+        uint32_t fields_off = fb.createOffsetVector(fields);
+        fb.startTable();
+        fb.addScalar<int16_t>(0, 0); // little endian
+        fb.addOffset(1, fields_off);
+        return fb.endTable();
+    }
+
+    std::vector<uint8_t> schemaMessage() const {
+        FlatBuilder fb;
+        uint32_t schema = buildSchema(fb);
+        fb.startTable();
+        fb.addScalar<int64_t>(3, 0);
+        fb.addOffset(2, schema);
+        fb.addScalar<int16_t>(0, kMetadataV5);
+        fb.addScalar<uint8_t>(1, kHeaderSchema);
+        return fb.finish(fb.endTable());
+    }
+
+    std::vector<uint8_t> batchMessage(const std::vector<uint8_t>& buffer_structs, uint64_t body_length) const {
+        FlatBuilder fb;
+        std::vector<uint8_t> nodes;
+        for (size_t i = 0; i < columns.size(); i++) {
+            putLE(nodes, rows, 8);
+            putLE(nodes, 0, 8); // null_count
+        }
+        uint32_t buffers_off = fb.createStructVector(buffer_structs, 16, 8);
+        uint32_t nodes_off = fb.createStructVector(nodes, 16, 8);
+        fb.startTable();
+        fb.addScalar<int64_t>(0, static_cast<int64_t>(rows));
+        fb.addOffset(1, nodes_off);
+        fb.addOffset(2, buffers_off);
+        uint32_t batch = fb.endTable();
+
+        fb.startTable();
+        fb.addScalar<int64_t>(3, static_cast<int64_t>(body_length));
+        fb.addOffset(2, batch);
+        fb.addScalar<int16_t>(0, kMetadataV5);
+        fb.addScalar<uint8_t>(1, kHeaderRecordBatch);
+        return fb.finish(fb.endTable());
+    }
+
+    std::vector<uint8_t> footerBuffer(uint64_t batch_offset, uint32_t batch_meta, uint64_t body_length) const {
+        FlatBuilder fb;
+        std::vector<uint8_t> block;
+        putLE(block, batch_offset, 8);
+        putLE(block, batch_meta, 4);
+        putLE(block, 0, 4); // padding
+        putLE(block, body_length, 8);
+        uint32_t batches_off = fb.createStructVector(block, 24, 8);
+        uint32_t dictionaries_off = fb.createStructVector({}, 24, 8);
+        uint32_t schema = buildSchema(fb);
+        fb.startTable();
+        fb.addOffset(1, schema);
+        fb.addOffset(2, dictionaries_off);
+        fb.addOffset(3, batches_off);
+        fb.addScalar<int16_t>(0, kMetadataV5);
+        return fb.finish(fb.endTable());
+    }
+
+    /* Continuation marker, padded metadata length, metadata, body. Returns the
+       metadata block length as recorded in the footer. */
+    static uint32_t appendMessage(std::vector<uint8_t>& file, std::vector<uint8_t> metadata,
+                                  const std::vector<uint8_t>& body) {
+        while ((metadata.size() + 8) % 8) metadata.push_back(0);
+        putLE(file, 0xFFFFFFFFu, 4);
+        putLE(file, metadata.size(), 4);
+        file.insert(file.end(), metadata.begin(), metadata.end());
+        file.insert(file.end(), body.begin(), body.end());
+        return static_cast<uint32_t>(metadata.size() + 8);
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef __EXT2FS_BLOCKMAP_H__
+#define __EXT2FS_BLOCKMAP_H__
+
+#include <stdint.h>
+#include <vector>
+#include "ext2fs.h"
+
+/* One data block of an inode, in logical order. root is the i_block slot the
+   block hangs off: 0 for direct blocks, 1..3 for the indirect trees. */
+struct BlockRef {
+    uint32_t logical;
+    uint32_t block;
+    int root;
+};
+
+/* Lazy walk of an inode's block map. Pointer blocks are fetched only when the
+   walk reaches them and are held one per level, so a triple indirect tree costs
+   three buffers. By default a pointer list ends at its first zero entry, which
+   is right for directories; with stop_at_hole false zero entries are skipped
+   as holes instead, so every block of a sparse file is reached.
+
+   Source supplies the I/O:
+     bool readPointers(uint32_t block, std::vector<char>& into);  false on failure
+     void prefetch(const uint32_t* blocks, uint32_t count);        advisory
+   Each freshly loaded pointer block is handed to prefetch() so its children are
+   in flight before the walk gets to them. A pointer block that cannot be read
+   ends its whole root tree, as does skipRoot() for data block failures. */
+template <class Source>
+class BlockMapIterator {
+public:
+    BlockMapIterator(const ext2_inode& inode, uint32_t block_size, Source& source, bool stop_at_hole = true)
+        : source(source), per_block(block_size / sizeof(uint32_t)), stop_at_hole(stop_at_hole) {
+        for (int i = 0; i < EXT2_NUM_DIRECT_BLOCKS; i++) roots[i] = inode.direct_blocks[i];
+        roots[EXT2_NUM_DIRECT_BLOCKS] = inode.single_indirect;
+        roots[EXT2_NUM_DIRECT_BLOCKS + 1] = inode.double_indirect;
+        roots[EXT2_NUM_DIRECT_BLOCKS + 2] = inode.triple_indirect;
+    }
+
+    bool next(BlockRef& out) {
+        while (true) {
+            if (depth == 0) {
+                if (!advanceRoot(out)) return false;
+                if (depth == 0) return true; // direct block
+                continue;
+            }
+            Level& level = levels[depth - 1];
+            if (level.index >= per_block || (stop_at_hole && level.ptrs()[level.index] == 0)) {
+                depth--;
+                if (depth == 0) continue;
+                levels[depth - 1].index++;
+                continue;
+            }
+            uint32_t ptr = level.ptrs()[level.index];
+            if (ptr == 0) {
+                level.index++;
+                continue;
+            }
+            if (depth == root_height) {
+                out = {logicalHere(), ptr, root_height};
+                level.index++;
+                return true;
+            }
+            if (!load(depth, ptr)) {
+                skipRoot();
+                continue;
+            }
+        }
+    }
+
+    // abandon what is left of the current indirect tree
+    void skipRoot() { depth = 0; }
+
+    uint32_t pointerBlocksRead() const { return pointer_blocks; }
+
+private:
+    struct Level {
+        std::vector<char> data;
+        uint32_t index = 0;
+        const uint32_t* ptrs() const { return reinterpret_cast<const uint32_t*>(data.data()); }
+    };
+
+    Source& source;
+    uint32_t per_block;
+    bool stop_at_hole;
+    uint32_t roots[EXT2_NUM_DIRECT_BLOCKS + 3];
+    int next_root = 0;
+    bool direct_done = false;
+    int root_height = 0;
+    int depth = 0;
+    uint32_t pointer_blocks = 0;
+    Level levels[3];
+
+    // Moves to the next i_block slot. Direct slots are yielded here; unless
+    // holes are allowed the walk stops at the first empty one.
+    bool advanceRoot(BlockRef& out) {
+        while (next_root < EXT2_NUM_DIRECT_BLOCKS + 3) {
+            int slot = next_root++;
+            uint32_t block = roots[slot];
+            if (slot < EXT2_NUM_DIRECT_BLOCKS) {
+                if (block == 0 && stop_at_hole) direct_done = true;
+                if (direct_done || block == 0) continue;
+                out = {static_cast<uint32_t>(slot), block, 0};
+                return true;
+            }
+            if (block == 0) continue;
+            root_height = slot - EXT2_NUM_DIRECT_BLOCKS + 1;
+            if (load(0, block)) return true;
+            depth = 0;
+        }
+        return false;
+    }
+
+    bool load(int at, uint32_t block) {
+        Level& level = levels[at];
+        level.index = 0;
+        if (!source.readPointers(block, level.data) || level.data.size() < per_block * sizeof(uint32_t)) {
+            return false;
+        }
+        pointer_blocks++;
+        uint32_t count = 0;
+        while (count < per_block && (!stop_at_hole || level.ptrs()[count] != 0)) count++;
+        source.prefetch(level.ptrs(), count);
+        depth = at + 1;
+        return true;
+    }
+
+    uint32_t logicalHere() const {
+        uint32_t logical = firstLogical(root_height), span = 1;
+        for (int d = root_height - 1; d >= 0; d--) {
+            logical += levels[d].index * span;
+            span *= per_block;
+        }
+        return logical;
+    }
+
+    uint32_t firstLogical(int height) const {
+        uint32_t first = EXT2_NUM_DIRECT_BLOCKS, span = 1;
+        for (int h = 1; h < height; h++) {
+            span *= per_block;
+            first += span;
+        }
+        return first;
+    }
+};
+
+#endif
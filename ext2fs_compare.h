@@ -0,0 +1,88 @@
+#ifndef __EXT2FS_COMPARE_H__
+#define __EXT2FS_COMPARE_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ext2fs.h"
+#include "ext2fs_inodetable.h"
+
+/* Live entries of one directory, sorted by (name, inode). */
+struct DirentSet {
+    uint32_t dir = 0;
+    std::vector<std::pair<std::string, uint32_t>> entries;
+};
+
+/* One block group of one image: its inode table as columns, row r being inode
+   first_inode + r, and the entries of its in-use directories by inode. Images
+   are compared a group at a time, so memory is bounded by the largest group. */
+struct GroupCatalog {
+    uint32_t first_inode = 1;
+    InodeColumns columns;
+    std::vector<DirentSet> dirs;
+};
+
+inline bool catalogInUse(const InodeColumns& c, size_t row) {
+    return row < c.rows() && c.mode[row] != 0 && c.link_count[row] != 0 && c.deletion_time[row] == 0;
+}
+
+/* Merge-joins the same group of an older and a newer image by inode number and
+   writes one line per difference:
+     created [inode]            deleted [inode]
+     modified [inode] FIELD OLD NEW     (FIELD blocks carries no values)
+     linked [dir] NAME inode    unlinked [dir] NAME inode
+   A row missing from one side (the volume grew or shrank) reads as zeroes. */
+inline void compareGroups(const GroupCatalog& older, const GroupCatalog& newer, std::ostream& out) {
+    const InodeColumns& a = older.columns;
+    const InodeColumns& b = newer.columns;
+    size_t rows = std::max(a.rows(), b.rows());
+    auto at = [](const std::vector<uint32_t>& col, size_t r) { return r < col.size() ? col[r] : 0u; };
+    auto at16 = [](const std::vector<uint16_t>& col, size_t r) { return r < col.size() ? col[r] : uint16_t(0); };
+    auto field = [&](uint32_t inode, const char* name, uint32_t x, uint32_t y) {
+        if (x != y) out << "modified [" << inode << "] " << name << " " << x << " " << y << "\n";
+    };
+
+    size_t da = 0, db = 0;
+    for (size_t r = 0; r < rows; r++) {
+        uint32_t inode = newer.first_inode + static_cast<uint32_t>(r);
+        bool was = catalogInUse(a, r), is = catalogInUse(b, r);
+        if (!was && is) out << "created [" << inode << "]\n";
+        else if (was && !is) out << "deleted [" << inode << "]\n";
+
+        field(inode, "mode", at16(a.mode, r), at16(b.mode, r));
+        field(inode, "links", at16(a.link_count, r), at16(b.link_count, r));
+        field(inode, "size", at(a.size, r), at(b.size, r));
+        field(inode, "atime", at(a.access_time, r), at(b.access_time, r));
+        field(inode, "ctime", at(a.change_time, r), at(b.change_time, r));
+        field(inode, "mtime", at(a.modification_time, r), at(b.modification_time, r));
+        field(inode, "dtime", at(a.deletion_time, r), at(b.deletion_time, r));
+        static const uint32_t none[EXT2_INODE_POINTERS] = {};
+        const uint32_t* pa = r < a.rows() ? a.blocks(r) : none;
+        const uint32_t* pb = r < b.rows() ? b.blocks(r) : none;
+        if (std::memcmp(pa, pb, sizeof(none)) != 0) out << "modified [" << inode << "] blocks\n";
+
+        // directory entries, joined on (name, inode)
+        static const DirentSet empty;
+        const DirentSet& x = da < older.dirs.size() && older.dirs[da].dir == inode ? older.dirs[da++] : empty;
+        const DirentSet& y = db < newer.dirs.size() && newer.dirs[db].dir == inode ? newer.dirs[db++] : empty;
+        size_t i = 0, j = 0;
+        while (i < x.entries.size() || j < y.entries.size()) {
+            if (j == y.entries.size() || (i < x.entries.size() && x.entries[i] < y.entries[j])) {
+                out << "unlinked [" << inode << "] " << x.entries[i].first << " " << x.entries[i].second << "\n";
+                i++;
+            } else if (i == x.entries.size() || y.entries[j] < x.entries[i]) {
+                out << "linked [" << inode << "] " << y.entries[j].first << " " << y.entries[j].second << "\n";
+                j++;
+            } else {
+                i++;
+                j++;
+            }
+        }
+    }
+}
+
+#endif
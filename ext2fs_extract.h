@@ -0,0 +1,252 @@
+#ifndef __EXT2FS_EXTRACT_H__
+#define __EXT2FS_EXTRACT_H__
+
+#include <stdint.h>
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <fstream>
+#include "ext2fs_reader.h"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ext2fs_hash.h"
+
+/* A run of file bytes stored contiguously in the image. */
+struct FileExtent {
+    uint64_t file_offset;
+    uint64_t image_offset;
+    uint64_t length;
+};
+
+/* One file to recover: where its mapped blocks are and how long it is. Bytes
+   not covered by an extent stay holes in the output. */
+struct ExtractJob {
+    std::string name;
+    uint64_t size = 0;
+    std::vector<FileExtent> extents;
+};
+
+/* A carved name made safe as one path component: '%', '/', NUL and control
+   bytes become %XX, and the result is cut to fit NAME_MAX after prefix. */
+inline std::string extractFileName(const std::string& prefix, const std::string& raw) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string name = prefix;
+    for (unsigned char c : raw) {
+        bool escape = c == '%' || c == '/' || c < 0x20 || c == 0x7F;
+        size_t need = escape ? 3 : 1;
+        if (name.size() + need > 255) break;
+        if (escape) {
+            name += '%';
+            name += hex[c >> 4];
+            name += hex[c & 0xF];
+        } else {
+            name += static_cast<char>(c);
+        }
+    }
+    return name;
+}
+
+/* Writes ExtractJobs under a directory straight from the image file. Each
+   extent goes through copy_file_range, so the data moves inside the kernel;
+   where that is refused (cross-device, old kernel) sendfile is used, and a
+   pread/pwrite loop only if both are. Files are spread over a thread pool.
+   The image is opened again, buffered, so the workers share nothing with the
+   scanner's reader.
+
+   With hash_block_size set (a --manifest run) the copy goes through user space
+   instead: every block is read whole, hashed for the ledger, then written, so
+   the manifest still lists each block the run read.
+
+   Off Linux there is no in-kernel copy: each file is read through its own
+   ImageReader and written through an ofstream, hashing as above. */
+class ContentExtractor {
+public:
+    ContentExtractor(const std::string& image_path, const std::string& dir, uint32_t hash_block_size = 0)
+        : dir(dir), hash_block_size(hash_block_size) {
+#if defined(__linux__)
+        in = ::open(image_path.c_str(), O_RDONLY);
+        if (in < 0) throw std::runtime_error("Failed to open image for extraction: " + image_path);
+        posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+        this->image_path = image_path;
+        ImageReader probe;
+        if (!probe.open(image_path, false)) throw std::runtime_error("Failed to open image for extraction: " + image_path);
+#endif
+    }
+#if defined(__linux__)
+    ~ContentExtractor() { ::close(in); }
+#endif
+    ContentExtractor(const ContentExtractor&) = delete;
+    ContentExtractor& operator=(const ContentExtractor&) = delete;
+
+    // returns the number of files written in full
+    size_t run(const std::vector<ExtractJob>& jobs) {
+        std::atomic<size_t> next{0}, written{0};
+        unsigned threads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                                           static_cast<unsigned>(jobs.size())));
+        std::vector<BlockHashLedger::Hashed> local(threads);
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back([&, t] {
+                for (size_t j = next++; j < jobs.size(); j = next++) {
+                    if (writeFile(jobs[j], local[t])) written++;
+                }
+            });
+        }
+        for (auto& worker : pool) worker.join();
+        for (const auto& blocks : local) hashed.insert(hashed.end(), blocks.begin(), blocks.end());
+        return written;
+    }
+
+    // blocks hashed by run(), for BlockHashLedger::merge
+    const BlockHashLedger::Hashed& hashedBlocks() const { return hashed; }
+
+private:
+#if defined(__linux__)
+    int in;
+#else
+    std::string image_path;
+#endif
+    std::string dir;
+    uint32_t hash_block_size;
+    BlockHashLedger::Hashed hashed;
+
+#if !defined(__linux__)
+    bool writeFile(const ExtractJob& job, BlockHashLedger::Hashed& blocks) {
+        ImageReader in;
+        if (!in.open(image_path, false)) return false;
+        std::string path = dir + "/" + job.name;
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.close();
+        std::error_code ec;
+        std::filesystem::resize_file(path, job.size, ec);
+        if (ec) return false;
+        out.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        std::vector<char> buffer(1 << 20);
+        uint64_t unit = hash_block_size ? hash_block_size : 1;
+        uint64_t want_max = buffer.size() / unit * unit;
+        for (const FileExtent& e : job.extents) {
+            uint64_t span = (e.length + unit - 1) / unit * unit;
+            for (uint64_t at = 0; at < span;) {
+                size_t want = static_cast<size_t>(std::min<uint64_t>(span - at, want_max));
+                if (in.readAt(e.image_offset + at, buffer.data(), want) != want) return false;
+                for (size_t b = 0; hash_block_size && b < want; b += hash_block_size) {
+                    uint32_t block_num = static_cast<uint32_t>((e.image_offset + at + b) / hash_block_size);
+                    blocks.push_back({block_num, xxh3::hash(buffer.data() + b, hash_block_size)});
+                }
+                size_t keep = static_cast<size_t>(std::min<uint64_t>(want, e.length - at));
+                out.seekp(static_cast<std::streamoff>(e.file_offset + at));
+                if (!out.write(buffer.data(), static_cast<std::streamsize>(keep))) return false;
+                at += want;
+            }
+        }
+        out.close();
+        return !out.fail();
+    }
+#else
+
+    bool writeFile(const ExtractJob& job, BlockHashLedger::Hashed& blocks) {
+        int out = ::open((dir + "/" + job.name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) return false;
+        bool ok = ::ftruncate(out, static_cast<off_t>(job.size)) == 0;
+        for (const FileExtent& e : job.extents) {
+            ok = ok && (hash_block_size ? copyHashed(out, e, blocks) : copyRange(out, e));
+        }
+        ::close(out);
+        return ok;
+    }
+
+    bool copyRange(int out, const FileExtent& e) {
+        loff_t src = static_cast<loff_t>(e.image_offset), dst = static_cast<loff_t>(e.file_offset);
+        uint64_t left = e.length;
+        while (left > 0) {
+            ssize_t n = ::copy_file_range(in, &src, out, &dst, left, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return sendRange(out, static_cast<uint64_t>(src), static_cast<uint64_t>(dst), left);
+            if (n == 0) return false; // image ends early
+            left -= static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    // sendfile reads at an explicit offset but writes at the output's position
+    bool sendRange(int out, uint64_t src, uint64_t dst, uint64_t left) {
+        if (::lseek(out, static_cast<off_t>(dst), SEEK_SET) < 0) return false;
+        off_t from = static_cast<off_t>(src);
+        while (left > 0) {
+            ssize_t n = ::sendfile(out, in, &from, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return copyBuffered(out, static_cast<uint64_t>(from), dst, left);
+            if (n == 0) return false;
+            dst += static_cast<uint64_t>(n);
+            left -= static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    // Extents start on a block boundary; the last one may end mid-block, but
+    // its whole block is read so the hash matches the scanner's.
+    bool copyHashed(int out, const FileExtent& e, BlockHashLedger::Hashed& blocks) {
+        std::vector<char> buffer(1 << 20);
+        uint64_t span = (e.length + hash_block_size - 1) / hash_block_size * hash_block_size;
+        uint64_t want_max = buffer.size() / hash_block_size * hash_block_size;
+        for (uint64_t at = 0; at < span;) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(span - at, want_max));
+            size_t got = 0;
+            while (got < want) {
+                ssize_t n = ::pread(in, buffer.data() + got, want - got, static_cast<off_t>(e.image_offset + at + got));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                got += static_cast<size_t>(n);
+            }
+            for (size_t b = 0; b < want; b += hash_block_size) {
+                uint32_t block_num = static_cast<uint32_t>((e.image_offset + at + b) / hash_block_size);
+                blocks.push_back({block_num, xxh3::hash(buffer.data() + b, hash_block_size)});
+            }
+            size_t keep = static_cast<size_t>(std::min<uint64_t>(want, e.length - at));
+            for (size_t done = 0; done < keep;) {
+                ssize_t w = ::pwrite(out, buffer.data() + done, keep - done, static_cast<off_t>(e.file_offset + at + done));
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) return false;
+                done += static_cast<size_t>(w);
+            }
+            at += want;
+        }
+        return true;
+    }
+
+    bool copyBuffered(int out, uint64_t src, uint64_t dst, uint64_t left) {
+        std::vector<char> buffer(1 << 20);
+        while (left > 0) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+            ssize_t n = ::pread(in, buffer.data(), want, static_cast<off_t>(src));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            size_t done = 0;
+            while (done < static_cast<size_t>(n)) {
+                ssize_t w = ::pwrite(out, buffer.data() + done, static_cast<size_t>(n) - done,
+                                     static_cast<off_t>(dst + done));
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) return false;
+                done += static_cast<size_t>(w);
+            }
+            src += done;
+            dst += done;
+            left -= done;
+        }
+        return true;
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef __EXT2FS_GEOMETRY_H__
+#define __EXT2FS_GEOMETRY_H__
+
+#include <stdint.h>
+#include "ext2fs.h"
+
+/* Where an inode lives: its group, the block inside that group's inode table
+   and the byte offset inside that block. */
+struct InodeSlot {
+    uint32_t group;
+    uint32_t block;
+    uint32_t offset;
+};
+
+constexpr uint32_t ext2_log2(uint32_t v) {
+    return v <= 1 ? 0 : 1 + ext2_log2(v >> 1);
+}
+
+constexpr bool ext2_is_pow2(uint32_t v) {
+    return v != 0 && (v & (v - 1)) == 0;
+}
+
+/* Block and inode geometry of an opened image. Built once from the superblock;
+   locate() points at a fixed-size instantiation for the common 1K/2K/4K block and
+   128/256-byte inode layouts, and at the generic division path otherwise. */
+struct Ext2Geometry {
+    uint32_t block_size;
+    uint32_t inode_size;
+    uint32_t inodes_per_group;
+    uint32_t block_shift;
+    uint32_t group_shift;  /* only valid when inodes_per_group is a power of two */
+    bool group_pow2;
+    InodeSlot (*locate)(const Ext2Geometry& geo, uint32_t inode_num);
+
+    uint64_t blockOffset(uint32_t block_num) const {
+        return static_cast<uint64_t>(block_num) << block_shift;
+    }
+
+    uint32_t inodesPerBlock() const { return block_size / inode_size; }
+
+    void splitGroup(uint32_t inode_num, uint32_t& group, uint32_t& index) const {
+        uint32_t n = inode_num - 1;
+        if (group_pow2) {
+            group = n >> group_shift;
+            index = n & (inodes_per_group - 1);
+        } else {
+            group = n / inodes_per_group;
+            index = n % inodes_per_group;
+        }
+    }
+};
+
+template <uint32_t BlockSize, uint32_t InodeSize>
+InodeSlot locateInodeFixed(const Ext2Geometry& geo, uint32_t inode_num) {
+    static_assert(ext2_is_pow2(BlockSize) && ext2_is_pow2(InodeSize) && InodeSize <= BlockSize,
+                  "fixed geometry needs power-of-two sizes");
+    constexpr uint32_t per_block_shift = ext2_log2(BlockSize / InodeSize);
+    constexpr uint32_t per_block_mask = (BlockSize / InodeSize) - 1;
+    constexpr uint32_t inode_shift = ext2_log2(InodeSize);
+
+    InodeSlot slot;
+    uint32_t index;
+    geo.splitGroup(inode_num, slot.group, index);
+    slot.block = index >> per_block_shift;
+    slot.offset = (index & per_block_mask) << inode_shift;
+    return slot;
+}
+
+inline InodeSlot locateInodeGeneric(const Ext2Geometry& geo, uint32_t inode_num) {
+    InodeSlot slot;
+    uint32_t index;
+    geo.splitGroup(inode_num, slot.group, index);
+    uint32_t per_block = geo.inodesPerBlock();
+    slot.block = index / per_block;
+    slot.offset = (index % per_block) * geo.inode_size;
+    return slot;
+}
+
+template <uint32_t BlockSize>
+InodeSlot (*selectInodeLocator(uint32_t inode_size))(const Ext2Geometry&, uint32_t) {
+    switch (inode_size) {
+        case 128: return &locateInodeFixed<BlockSize, 128>;
+        case 256: return &locateInodeFixed<BlockSize, 256>;
+        default:  return &locateInodeGeneric;
+    }
+}
+
+/* Returns false when the sizes cannot describe a readable image. */
+inline bool makeGeometry(uint32_t block_size, uint32_t inode_size, uint32_t inodes_per_group,
+                         Ext2Geometry& geo) {
+    // every inode slot must hold a whole ext2_inode; sizes are powers of two
+    if (!ext2_is_pow2(block_size) || inode_size < sizeof(ext2_inode) || !ext2_is_pow2(inode_size) ||
+        inode_size > block_size || inodes_per_group == 0) {
+        return false;
+    }
+    geo.block_size = block_size;
+    geo.inode_size = inode_size;
+    geo.inodes_per_group = inodes_per_group;
+    geo.block_shift = ext2_log2(block_size);
+    geo.group_pow2 = ext2_is_pow2(inodes_per_group);
+    geo.group_shift = geo.group_pow2 ? ext2_log2(inodes_per_group) : 0;
+
+    switch (block_size) {
+        case 1024: geo.locate = selectInodeLocator<1024>(inode_size); break;
+        case 2048: geo.locate = selectInodeLocator<2048>(inode_size); break;
+        case 4096: geo.locate = selectInodeLocator<4096>(inode_size); break;
+        default:   geo.locate = &locateInodeGeneric; break;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,386 @@
+#ifndef __EXT2FS_HASH_H__
+#define __EXT2FS_HASH_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* XXH3 64-bit (reference algorithm, default secret, seed 0). Blocks are
+   longer than 240 bytes, so they take the striped path: eight 64-bit lanes
+   fed 64 bytes at a time, which on x86-64 runs as AVX2 when the CPU has it. */
+namespace xxh3 {
+
+constexpr uint64_t P32_1 = 0x9E3779B1U;
+constexpr uint64_t P32_2 = 0x85EBCA77U;
+constexpr uint64_t P32_3 = 0xC2B2AE3DU;
+constexpr uint64_t P64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t P64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t P64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t P64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t P64_5 = 0x27D4EB2F165667C5ULL;
+constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+constexpr size_t STRIPE = 64;
+constexpr size_t SECRET_SIZE = 192;
+constexpr size_t STRIPES_PER_BLOCK = (SECRET_SIZE - STRIPE) / 8;
+
+alignas(64) constexpr unsigned char kSecret[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t swap64(uint64_t x) {
+    return ((x << 56) & 0xff00000000000000ULL) | ((x << 40) & 0x00ff000000000000ULL) |
+           ((x << 24) & 0x0000ff0000000000ULL) | ((x << 8) & 0x000000ff00000000ULL) |
+           ((x >> 8) & 0x00000000ff000000ULL) | ((x >> 24) & 0x0000000000ff0000ULL) |
+           ((x >> 40) & 0x000000000000ff00ULL) | ((x >> 56) & 0x00000000000000ffULL);
+}
+
+// low half xor high half of the 128-bit product
+inline uint64_t mulFold(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+inline uint64_t avalanche64(uint64_t h) {
+    h ^= h >> 33;
+    h *= P64_2;
+    h ^= h >> 29;
+    h *= P64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t rrmxmx(uint64_t h, uint64_t len) {
+    h ^= rotl(h, 49) ^ rotl(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+inline uint64_t mix16(const unsigned char* p, const unsigned char* secret) {
+    return mulFold(read64(p) ^ read64(secret), read64(p + 8) ^ read64(secret + 8));
+}
+
+inline void accumulateStripe(uint64_t* acc, const unsigned char* p, const unsigned char* secret) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t value = read64(p + 8 * i);
+        uint64_t key = value ^ read64(secret + 8 * i);
+        acc[i ^ 1] += value;
+        acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+}
+
+inline void scramble(uint64_t* acc, const unsigned char* secret) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(secret + 8 * i);
+        acc[i] = a * P32_1;
+    }
+}
+
+// Every stripe of a long input: full 1 KiB blocks, each followed by a
+// scramble, then the partial last block and a final stripe flush with the end.
+inline void accumulateLong(uint64_t* acc, const unsigned char* p, size_t len) {
+    const size_t block_len = STRIPE * STRIPES_PER_BLOCK;
+    size_t blocks = (len - 1) / block_len;
+    for (size_t n = 0; n < blocks; n++, p += block_len) {
+        for (size_t s = 0; s < STRIPES_PER_BLOCK; s++) accumulateStripe(acc, p + s * STRIPE, kSecret + s * 8);
+        scramble(acc, kSecret + SECRET_SIZE - STRIPE);
+    }
+    size_t stripes = ((len - 1) - blocks * block_len) / STRIPE;
+    for (size_t s = 0; s < stripes; s++) accumulateStripe(acc, p + s * STRIPE, kSecret + s * 8);
+    accumulateStripe(acc, p + (len - blocks * block_len) - STRIPE, kSecret + SECRET_SIZE - STRIPE - 7);
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+} // namespace xxh3
+#include <immintrin.h>
+namespace xxh3 {
+
+__attribute__((target("avx2"), always_inline))
+inline void stripeAvx2(__m256i* a, const unsigned char* in, const unsigned char* secret) {
+    for (int h = 0; h < 2; h++) {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32 * h));
+        __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 32 * h));
+        __m256i mixed = _mm256_xor_si256(value, key);
+        __m256i product = _mm256_mul_epu32(mixed, _mm256_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m256i swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+        a[h] = _mm256_add_epi64(product, _mm256_add_epi64(a[h], swapped));
+    }
+}
+
+// accumulateLong with the eight lanes held in two AVX2 registers
+__attribute__((target("avx2")))
+inline void accumulateLongAvx2(uint64_t* acc, const unsigned char* p, size_t len) {
+    __m256i a[2] = {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc)),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4))};
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(P32_1));
+    const size_t block_len = STRIPE * STRIPES_PER_BLOCK;
+    size_t blocks = (len - 1) / block_len;
+    for (size_t n = 0; n < blocks; n++, p += block_len) {
+        for (size_t s = 0; s < STRIPES_PER_BLOCK; s++) stripeAvx2(a, p + s * STRIPE, kSecret + s * 8);
+        for (int h = 0; h < 2; h++) {
+            __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kSecret + SECRET_SIZE - STRIPE + 32 * h));
+            __m256i mixed = _mm256_xor_si256(_mm256_xor_si256(a[h], _mm256_srli_epi64(a[h], 47)), key);
+            __m256i lo = _mm256_mul_epu32(mixed, prime);
+            __m256i hi = _mm256_mul_epu32(_mm256_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            a[h] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+        }
+    }
+    size_t stripes = ((len - 1) - blocks * block_len) / STRIPE;
+    for (size_t s = 0; s < stripes; s++) stripeAvx2(a, p + s * STRIPE, kSecret + s * 8);
+    stripeAvx2(a, p + (len - blocks * block_len) - STRIPE, kSecret + SECRET_SIZE - STRIPE - 7);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a[0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4), a[1]);
+}
+
+inline bool haveAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+inline uint64_t hashLong(const unsigned char* p, size_t len) {
+    uint64_t acc[8] = {P32_3, P64_1, P64_2, P64_3, P64_4, P32_2, P64_5, P32_1};
+#if defined(__GNUC__) && defined(__x86_64__)
+    if (haveAvx2()) accumulateLongAvx2(acc, p, len);
+    else accumulateLong(acc, p, len);
+#else
+    accumulateLong(acc, p, len);
+#endif
+    uint64_t h = len * P64_1;
+    for (int i = 0; i < 4; i++) {
+        const unsigned char* secret = kSecret + 11 + 16 * i;
+        h += mulFold(acc[2 * i] ^ read64(secret), acc[2 * i + 1] ^ read64(secret + 8));
+    }
+    return avalanche(h);
+}
+
+inline uint64_t hash(const void* data, size_t len) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* secret = kSecret;
+    if (len > 240) return hashLong(p, len);
+    if (len > 128) {
+        uint64_t acc = len * P64_1;
+        for (size_t i = 0; i < 8; i++) acc += mix16(p + 16 * i, secret + 16 * i);
+        acc = avalanche(acc);
+        for (size_t i = 8; i < len / 16; i++) acc += mix16(p + 16 * i, secret + 16 * (i - 8) + 3);
+        acc += mix16(p + len - 16, secret + 136 - 17);
+        return avalanche(acc);
+    }
+    if (len > 16) {
+        uint64_t acc = len * P64_1;
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += mix16(p + 48, secret + 96);
+                    acc += mix16(p + len - 64, secret + 112);
+                }
+                acc += mix16(p + 32, secret + 64);
+                acc += mix16(p + len - 48, secret + 80);
+            }
+            acc += mix16(p + 16, secret + 32);
+            acc += mix16(p + len - 32, secret + 48);
+        }
+        acc += mix16(p, secret);
+        acc += mix16(p + len - 16, secret + 16);
+        return avalanche(acc);
+    }
+    if (len > 8) {
+        uint64_t lo = read64(p) ^ (read64(secret + 24) ^ read64(secret + 32));
+        uint64_t hi = read64(p + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+        return avalanche(len + swap64(lo) + hi + mulFold(lo, hi));
+    }
+    if (len >= 4) {
+        uint64_t input = read32(p + len - 4) + (static_cast<uint64_t>(read32(p)) << 32);
+        return rrmxmx(input ^ (read64(secret + 8) ^ read64(secret + 16)), len);
+    }
+    if (len > 0) {
+        uint32_t combined = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[len >> 1]) << 24) |
+                            p[len - 1] | (static_cast<uint32_t>(len) << 8);
+        return avalanche64(combined ^ static_cast<uint64_t>(read32(secret) ^ read32(secret + 4)));
+    }
+    return avalanche64(read64(secret + 56) ^ read64(secret + 64));
+}
+
+} // namespace xxh3
+
+/* Hash of every distinct block the analysis read. A block read again is
+   re-hashed and compared, so content that changed under the tool is caught;
+   callers that re-read one block many times (inode table lookups) can check
+   recorded() and hash it only once. */
+class BlockHashLedger {
+public:
+    BlockHashLedger(uint32_t block_count, uint32_t first_data_block, uint32_t blocks_per_group,
+                    uint32_t group_count)
+        : hashes(block_count, 0), seen(block_count, false), first_data_block(first_data_block),
+          blocks_per_group(blocks_per_group), group_count(group_count) {}
+
+    // (block number, xxh3 of its contents) as hashed off the scanner's thread
+    using Hashed = std::vector<std::pair<uint32_t, uint64_t>>;
+
+    void record(uint32_t block_num, const void* data, size_t len) {
+        recordHash(block_num, xxh3::hash(data, len));
+    }
+
+    // Worker threads hash into their own Hashed lists; the lists are merged
+    // here afterwards, on one thread, with the same re-read check as record().
+    void merge(const Hashed& blocks) {
+        for (const auto& [block_num, h] : blocks) recordHash(block_num, h);
+    }
+
+    void recordHash(uint32_t block_num, uint64_t h) {
+        if (block_num >= hashes.size()) return;
+        if (seen[block_num]) {
+            if (hashes[block_num] != h) mismatches++;
+            return;
+        }
+        seen[block_num] = true;
+        hashes[block_num] = h;
+    }
+
+    bool recorded(uint32_t block_num) const { return block_num < seen.size() && seen[block_num]; }
+
+    uint64_t mismatchCount() const { return mismatches; }
+
+    /* Per-group digests are computed in parallel: each is the XXH3 of the
+       (block number, block hash) pairs of the group's read blocks, in order. */
+    void writeManifest(const std::string& filename, const std::string& image, uint32_t block_size) const {
+        uint32_t groups = std::max(1u, group_count);
+        std::vector<uint64_t> digests(groups, 0);
+        std::vector<uint32_t> counts(groups, 0);
+
+        std::atomic<uint32_t> next{0};
+        auto worker = [&] {
+            std::vector<uint64_t> pairs;
+            for (uint32_t g; (g = next.fetch_add(1)) < groups;) {
+                pairs.clear();
+                uint64_t first = groupStart(g);
+                uint64_t last = g + 1 == groups ? hashes.size() : std::min<uint64_t>(groupStart(g + 1), hashes.size());
+                for (uint64_t b = first; b < last; b++) {
+                    if (!seen[b]) continue;
+                    pairs.push_back(b);
+                    pairs.push_back(hashes[b]);
+                }
+                counts[g] = static_cast<uint32_t>(pairs.size() / 2);
+                digests[g] = xxh3::hash(pairs.data(), pairs.size() * sizeof(uint64_t));
+            }
+        };
+        unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), groups));
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+
+        std::ofstream out(filename);
+        if (!out) throw std::runtime_error("Failed to open manifest: " + filename);
+        char line[96];
+        out << "# histext2fs block read manifest\n";
+        out << "algorithm xxh3\n";
+        out << "image " << image << "\n";
+        out << "block_size " << block_size << "\n";
+        uint64_t total = 0;
+        for (uint32_t g = 0; g < groups; g++) total += counts[g];
+        out << "blocks_read " << total << "\n";
+        out << "reread_mismatches " << mismatches << "\n";
+        for (uint32_t g = 0; g < groups; g++) {
+            std::snprintf(line, sizeof(line), "group %u blocks %u digest %016llx\n", g, counts[g],
+                          static_cast<unsigned long long>(digests[g]));
+            out << line;
+        }
+        out << "image_digest ";
+        std::snprintf(line, sizeof(line), "%016llx\n",
+                      static_cast<unsigned long long>(xxh3::hash(digests.data(), digests.size() * sizeof(uint64_t))));
+        out << line;
+
+        // one line per read block, formatted by hand into one buffer, since
+        // a full --sequential scan lists every block of the image
+        static const char hex[] = "0123456789abcdef";
+        std::string body(static_cast<size_t>(total) * 34, '\0');
+        char* at = &body[0];
+        for (uint64_t b = 0; b < hashes.size(); b++) {
+            if (!seen[b]) continue;
+            std::memcpy(at, "block ", 6);
+            at += 6;
+            char digits[20];
+            int n = 0;
+            for (uint64_t v = b; n == 0 || v != 0; v /= 10) digits[n++] = static_cast<char>('0' + v % 10);
+            while (n > 0) *at++ = digits[--n];
+            *at++ = ' ';
+            for (int shift = 60; shift >= 0; shift -= 4) *at++ = hex[(hashes[b] >> shift) & 0xF];
+            *at++ = '\n';
+        }
+        body.resize(static_cast<size_t>(at - body.data()));
+        out.write(body.data(), static_cast<std::streamsize>(body.size()));
+    }
+
+private:
+    std::vector<uint64_t> hashes;
+    std::vector<bool> seen;
+    uint32_t first_data_block;
+    uint32_t blocks_per_group;
+    uint32_t group_count;
+    uint64_t mismatches = 0;
+
+    // group g covers [first_data_block + g * blocks_per_group, ...); the boot
+    // block before first_data_block is counted in group 0
+    uint64_t groupStart(uint32_t g) const {
+        return g == 0 ? 0 : static_cast<uint64_t>(first_data_block) + static_cast<uint64_t>(g) * blocks_per_group;
+    }
+};
+
+#endif
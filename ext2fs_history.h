@@ -0,0 +1,357 @@
+#ifndef __EXT2FS_HISTORY_H__
+#define __EXT2FS_HISTORY_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Action {
+    uint32_t timestamp;
+    std::string action;
+    std::vector<std::string> args;
+    std::vector<uint32_t> affected_dirs;
+    std::vector<uint32_t> affected_inodes;
+    bool heuristic = false; /* endpoints picked by timestamp matching among several ghosts */
+    /* rm/rmdir under --intact: data blocks still mapped by the inode, and how
+       many of them are free and unowned, i.e. still hold the deleted data */
+    bool intact_known = false;
+    uint32_t data_blocks = 0;
+    uint32_t intact_blocks = 0;
+};
+
+/* Per-record confidence bits carried by the machine-readable sinks. */
+#define HIST_TIME_KNOWN   0x01
+#define HIST_PATHS_KNOWN  0x02
+#define HIST_DIRS_KNOWN   0x04
+#define HIST_HEURISTIC    0x08
+
+#define HIST_BINARY_MAGIC   0x42483245u /* "E2HB" */
+#define HIST_BINARY_VERSION 1u
+
+enum class HistoryFormat { Text, Ndjson, Binary };
+
+inline bool historyArgKnown(const std::string& arg) {
+    return !arg.empty() && arg != "?";
+}
+
+/* Length of the well-formed UTF-8 sequence at p (no overlongs, surrogates or
+   code points past U+10FFFF), or 0 if the bytes there are not one. */
+inline size_t utf8SequenceLength(const unsigned char* p, size_t avail) {
+    unsigned char c = p[0];
+    if (c < 0x80) return 1;
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) len = 2;
+    else if (c >= 0xE0 && c <= 0xEF) {
+        len = 3;
+        if (c == 0xE0) lo = 0xA0;
+        if (c == 0xED) hi = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        len = 4;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;
+    } else return 0;
+    if (avail < len || p[1] < lo || p[1] > hi) return 0;
+    for (size_t i = 2; i < len; i++) {
+        if (p[i] < 0x80 || p[i] > 0xBF) return 0;
+    }
+    return len;
+}
+
+inline bool validUtf8(const std::string& s) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+    for (size_t i = 0, n = s.size(); i < n;) {
+        size_t len = utf8SequenceLength(p + i, n - i);
+        if (len == 0) return false;
+        i += len;
+    }
+    return true;
+}
+
+inline uint8_t historyFlags(const Action& action) {
+    uint8_t flags = 0;
+    if (action.timestamp != 0) flags |= HIST_TIME_KNOWN;
+    bool paths = true, dirs = true;
+    for (const auto& a : action.args) paths = paths && historyArgKnown(a);
+    for (uint32_t d : action.affected_dirs) dirs = dirs && d != 0;
+    if (paths) flags |= HIST_PATHS_KNOWN;
+    if (dirs) flags |= HIST_DIRS_KNOWN;
+    if (action.heuristic) flags |= HIST_HEURISTIC;
+    return flags;
+}
+
+/* Order of actions sharing a timestamp: creations, then moves, then removals. */
+inline uint8_t actionRank(const std::string& action) {
+    if (action == "mkdir") return 0;
+    if (action == "touch") return 1;
+    if (action == "rm") return 3;
+    if (action == "rmdir") return 4;
+    return 2;
+}
+
+/* Indices of actions ordered by (timestamp, first inode, rank, position), with
+   unknown times (0) first. LSD radix sort over a compact key array: each byte
+   pass is a stable counting sort of the indices, so the original position
+   breaks the remaining ties and the order is the same on every run. Passes
+   whose byte is equal for every key are skipped. */
+inline std::vector<uint32_t> chronologicalOrder(const std::vector<Action>& actions) {
+    size_t n = actions.size();
+    std::vector<uint32_t> times(n), inodes(n);
+    std::vector<uint8_t> ranks(n);
+    for (size_t i = 0; i < n; i++) {
+        times[i] = actions[i].timestamp;
+        inodes[i] = actions[i].affected_inodes.empty() ? 0 : actions[i].affected_inodes[0];
+        ranks[i] = actionRank(actions[i].action);
+    }
+    std::vector<uint32_t> order(n), scratch(n);
+    std::iota(order.begin(), order.end(), 0u);
+
+    auto pass = [&](auto digit) {
+        size_t start[257] = {};
+        for (uint32_t k : order) start[digit(k) + 1]++;
+        for (int d = 0; d < 256; d++) {
+            if (start[d + 1] == n) return;
+        }
+        for (int d = 0; d < 256; d++) start[d + 1] += start[d];
+        for (uint32_t k : order) scratch[start[digit(k)]++] = k;
+        order.swap(scratch);
+    };
+    pass([&](uint32_t k) { return ranks[k]; });
+    for (int shift = 0; shift < 32; shift += 8) {
+        pass([&](uint32_t k) { return (inodes[k] >> shift) & 0xFF; });
+    }
+    for (int shift = 0; shift < 32; shift += 8) {
+        pass([&](uint32_t k) { return (times[k] >> shift) & 0xFF; });
+    }
+    return order;
+}
+
+class HistorySink {
+public:
+    explicit HistorySink(std::ostream& out) : out(out) {}
+    virtual ~HistorySink() = default;
+    virtual void write(const Action& action) = 0;
+
+protected:
+    std::ostream& out;
+};
+
+/* `ts action [args] [dirs] [inodes]` with `?` for anything unknown. */
+class TextHistorySink : public HistorySink {
+public:
+    using HistorySink::HistorySink;
+
+    void write(const Action& action) override {
+        if (action.timestamp == 0) out << "? " << action.action << " [";
+        else out << action.timestamp << " " << action.action << " [";
+        for (size_t i = 0; i < action.args.size(); ++i) {
+            if (i) out << " ";
+            if (action.args[i] == "") out << "?";
+            else out << action.args[i];
+        }
+        out << "] [";
+        writeNumbers(action.affected_dirs);
+        out << "] [";
+        writeNumbers(action.affected_inodes);
+        out << "]";
+        if (action.intact_known) out << " intact " << action.intact_blocks << "/" << action.data_blocks;
+        out << "\n";
+    }
+
+private:
+    void writeNumbers(const std::vector<uint32_t>& values) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i) out << " ";
+            if (values[i] == 0) out << "?";
+            else out << values[i];
+        }
+    }
+};
+
+/* One JSON object per line; unknown values are null. Ext2 names are bytes, not
+   text: a byte that is not part of valid UTF-8 is written as \u00XX, and the
+   record then carries "args_raw" with the base64 of every such argument's
+   exact bytes (null for the arguments that were valid). */
+class NdjsonHistorySink : public HistorySink {
+public:
+    using HistorySink::HistorySink;
+
+    void write(const Action& action) override {
+        line.clear();
+        line += "{\"ts\":";
+        appendNumber(action.timestamp);
+        line += ",\"action\":";
+        appendString(action.action);
+        line += ",\"args\":[";
+        for (size_t i = 0; i < action.args.size(); ++i) {
+            if (i) line += ',';
+            if (historyArgKnown(action.args[i])) appendString(action.args[i]);
+            else line += "null";
+        }
+        line += ']';
+        bool raw = false;
+        for (const auto& a : action.args) raw = raw || !validUtf8(a);
+        if (raw) {
+            line += ",\"args_raw\":[";
+            for (size_t i = 0; i < action.args.size(); ++i) {
+                if (i) line += ',';
+                if (validUtf8(action.args[i])) {
+                    line += "null";
+                } else {
+                    line += '"';
+                    appendBase64(action.args[i]);
+                    line += '"';
+                }
+            }
+            line += ']';
+        }
+        line += ",\"dirs\":";
+        appendNumbers(action.affected_dirs);
+        line += ",\"inodes\":";
+        appendNumbers(action.affected_inodes);
+        uint8_t flags = historyFlags(action);
+        line += ",\"time_known\":";
+        line += (flags & HIST_TIME_KNOWN) ? "true" : "false";
+        line += ",\"paths_known\":";
+        line += (flags & HIST_PATHS_KNOWN) ? "true" : "false";
+        line += ",\"dirs_known\":";
+        line += (flags & HIST_DIRS_KNOWN) ? "true" : "false";
+        line += ",\"heuristic\":";
+        line += (flags & HIST_HEURISTIC) ? "true" : "false";
+        if (action.intact_known) {
+            line += ",\"data_blocks\":" + std::to_string(action.data_blocks);
+            line += ",\"intact_blocks\":" + std::to_string(action.intact_blocks);
+        }
+        line += "}\n";
+        out.write(line.data(), static_cast<std::streamsize>(line.size()));
+    }
+
+private:
+    std::string line;
+
+    void appendNumber(uint32_t v) {
+        if (v == 0) {
+            line += "null";
+            return;
+        }
+        char buf[16];
+        int n = std::snprintf(buf, sizeof(buf), "%u", v);
+        line.append(buf, static_cast<size_t>(n));
+    }
+
+    void appendNumbers(const std::vector<uint32_t>& values) {
+        line += '[';
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i) line += ',';
+            appendNumber(values[i]);
+        }
+        line += ']';
+    }
+
+    void appendString(const std::string& s) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+        line += '"';
+        for (size_t i = 0, n = s.size(); i < n;) {
+            unsigned char c = p[i];
+            if (c == '"' || c == '\\') {
+                line += '\\';
+                line += static_cast<char>(c);
+                i++;
+                continue;
+            }
+            size_t len = c < 0x20 ? 0 : utf8SequenceLength(p + i, n - i);
+            if (len == 0) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                line += buf;
+                i++;
+            } else {
+                line.append(s, i, len);
+                i += len;
+            }
+        }
+        line += '"';
+    }
+
+    void appendBase64(const std::string& s) {
+        static const char digits[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+        size_t n = s.size(), i = 0;
+        for (; i + 3 <= n; i += 3) {
+            uint32_t v = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+            line += digits[v >> 18];
+            line += digits[(v >> 12) & 63];
+            line += digits[(v >> 6) & 63];
+            line += digits[v & 63];
+        }
+        if (i < n) {
+            uint32_t v = p[i] << 16;
+            if (i + 1 < n) v |= p[i + 1] << 8;
+            line += digits[v >> 18];
+            line += digits[(v >> 12) & 63];
+            line += i + 1 < n ? digits[(v >> 6) & 63] : '=';
+            line += '=';
+        }
+    }
+};
+
+/* Little-endian length-prefixed records after an 8-byte header:
+     u32 record_length (bytes after this field), u32 timestamp, u8 kind, u8 flags,
+     u8 argc, argc x (u16 length, bytes), u8 dirc, dirc x u32, u8 inodec, inodec x u32
+   kind: 0 touch, 1 mkdir, 2 rm, 3 rmdir, 4 mv. Unknown args have length 0 and
+   unknown numbers are 0. */
+class BinaryHistorySink : public HistorySink {
+public:
+    explicit BinaryHistorySink(std::ostream& out) : HistorySink(out) {
+        record.clear();
+        putU32(HIST_BINARY_MAGIC);
+        putU32(HIST_BINARY_VERSION);
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+    }
+
+    static uint8_t kindOf(const std::string& action) {
+        if (action == "touch") return 0;
+        if (action == "mkdir") return 1;
+        if (action == "rm") return 2;
+        if (action == "rmdir") return 3;
+        return 4;
+    }
+
+    void write(const Action& action) override {
+        record.assign(4, '\0');
+        putU32(action.timestamp);
+        record += static_cast<char>(kindOf(action.action));
+        record += static_cast<char>(historyFlags(action));
+        record += static_cast<char>(action.args.size());
+        for (const auto& a : action.args) {
+            size_t len = historyArgKnown(a) ? std::min<size_t>(a.size(), 0xFFFF) : 0;
+            record += static_cast<char>(len & 0xFF);
+            record += static_cast<char>(len >> 8);
+            record.append(a.data(), len);
+        }
+        putList(action.affected_dirs);
+        putList(action.affected_inodes);
+        uint32_t body = static_cast<uint32_t>(record.size() - 4);
+        for (int i = 0; i < 4; i++) record[i] = static_cast<char>((body >> (8 * i)) & 0xFF);
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+    }
+
+private:
+    std::string record;
+
+    void putU32(uint32_t v) {
+        for (int i = 0; i < 4; i++) record += static_cast<char>((v >> (8 * i)) & 0xFF);
+    }
+
+    void putList(const std::vector<uint32_t>& values) {
+        record += static_cast<char>(values.size());
+        for (uint32_t v : values) putU32(v);
+    }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef __EXT2FS_INDEX_H__
+#define __EXT2FS_INDEX_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ext2fs.h"
+
+#define EXT2_INDEX_MAGIC 0x58493245u /* "E2IX" */
+#define EXT2_INDEX_VERSION 1u
+#define EXT2_INDEX_MIN_RECORD 17u /* inode, parent, ghost flag, two string lengths */
+
+/* One dirent seen during recovery, live or carved from slack. */
+struct DirentRecord {
+    uint32_t inode;
+    uint32_t parent_inode;
+    bool is_ghost;
+    std::string name;
+    std::string full_path;
+};
+
+/* Lookup index over recovered dirents keyed by (parent inode, name hash), plus a
+   name-only key for bare-name queries. Hash collisions are resolved by comparing
+   the stored name. Only the records are persisted; the hash tables are rebuilt
+   on load in one linear pass. */
+class DirentIndex {
+public:
+    static uint32_t hashName(std::string_view name) {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (unsigned char c : name) {
+            h ^= c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    void add(DirentRecord record) {
+        uint32_t idx = static_cast<uint32_t>(records.size());
+        uint32_t h = hashName(record.name);
+        by_parent.emplace(key(record.parent_inode, h), idx);
+        by_name.emplace(h, idx);
+        by_inode.emplace(record.inode, idx);
+        records.push_back(std::move(record));
+    }
+
+    size_t size() const { return records.size(); }
+    const DirentRecord& at(uint32_t idx) const { return records[idx]; }
+
+    std::vector<uint32_t> lookupChild(uint32_t parent_inode, std::string_view name) const {
+        std::vector<uint32_t> out;
+        auto range = by_parent.equal_range(key(parent_inode, hashName(name)));
+        for (auto it = range.first; it != range.second; ++it) {
+            if (records[it->second].name == name) out.push_back(it->second);
+        }
+        return out;
+    }
+
+    std::vector<uint32_t> lookupName(std::string_view name) const {
+        std::vector<uint32_t> out;
+        auto range = by_name.equal_range(hashName(name));
+        for (auto it = range.first; it != range.second; ++it) {
+            if (records[it->second].name == name) out.push_back(it->second);
+        }
+        return out;
+    }
+
+    std::vector<uint32_t> lookupInode(uint32_t inode) const {
+        std::vector<uint32_t> out;
+        auto range = by_inode.equal_range(inode);
+        for (auto it = range.first; it != range.second; ++it) out.push_back(it->second);
+        std::sort(out.begin(), out.end()); // recovery order
+        return out;
+    }
+
+    /* Walks "/a/b/c" from the root through live and ghost dirents alike, so a
+       path that only existed in the past still resolves. A query without '/' is
+       a bare-name lookup anywhere in the tree. */
+    std::vector<uint32_t> resolve(std::string_view path) const {
+        if (path.find('/') == std::string_view::npos) {
+            return lookupName(path);
+        }
+        std::vector<uint32_t> parents = {EXT2_ROOT_INODE};
+        std::vector<uint32_t> matches;
+        size_t pos = 0;
+        while (pos < path.size()) {
+            size_t next = path.find('/', pos);
+            if (next == std::string_view::npos) next = path.size();
+            std::string_view component = path.substr(pos, next - pos);
+            pos = next + 1;
+            if (component.empty()) continue;
+
+            matches.clear();
+            for (uint32_t parent : parents) {
+                auto found = lookupChild(parent, component);
+                matches.insert(matches.end(), found.begin(), found.end());
+            }
+            parents.clear();
+            for (uint32_t idx : matches) parents.push_back(records[idx].inode);
+            if (parents.empty()) break;
+        }
+        return matches;
+    }
+
+    void save(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out) throw std::runtime_error("Failed to open index for writing: " + filename);
+        putU32(out, EXT2_INDEX_MAGIC);
+        putU32(out, EXT2_INDEX_VERSION);
+        putU32(out, static_cast<uint32_t>(records.size()));
+        for (const auto& r : records) {
+            putU32(out, r.inode);
+            putU32(out, r.parent_inode);
+            out.put(r.is_ghost ? 1 : 0);
+            putString(out, r.name);
+            putString(out, r.full_path);
+        }
+        if (!out) throw std::runtime_error("Failed to write index: " + filename);
+    }
+
+    static DirentIndex load(const std::string& filename) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in) throw std::runtime_error("Failed to open index: " + filename);
+        if (getU32(in) != EXT2_INDEX_MAGIC || getU32(in) != EXT2_INDEX_VERSION) {
+            throw std::runtime_error("Not a dirent index: " + filename);
+        }
+        DirentIndex index;
+        uint32_t count = getU32(in);
+        // the count is untrusted: every record needs at least its fixed fields
+        std::streamoff header = in.tellg();
+        in.seekg(0, std::ios::end);
+        std::streamoff remaining = in.tellg() - header;
+        in.seekg(header);
+        if (!in || static_cast<uint64_t>(count) * EXT2_INDEX_MIN_RECORD > static_cast<uint64_t>(remaining)) {
+            throw std::runtime_error("Truncated index: " + filename);
+        }
+        index.records.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            DirentRecord r;
+            r.inode = getU32(in);
+            r.parent_inode = getU32(in);
+            r.is_ghost = in.get() != 0;
+            r.name = getString(in);
+            r.full_path = getString(in);
+            if (!in) throw std::runtime_error("Truncated index: " + filename);
+            index.add(std::move(r));
+        }
+        return index;
+    }
+
+private:
+    std::vector<DirentRecord> records;
+    std::unordered_multimap<uint64_t, uint32_t> by_parent;
+    std::unordered_multimap<uint32_t, uint32_t> by_name;
+    std::unordered_multimap<uint32_t, uint32_t> by_inode;
+
+    static uint64_t key(uint32_t parent_inode, uint32_t name_hash) {
+        return (static_cast<uint64_t>(parent_inode) << 32) | name_hash;
+    }
+
+    static void putU32(std::ofstream& out, uint32_t v) {
+        unsigned char b[4] = {uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24)};
+        out.write(reinterpret_cast<const char*>(b), 4);
+    }
+
+    static uint32_t getU32(std::ifstream& in) {
+        unsigned char b[4] = {0, 0, 0, 0};
+        in.read(reinterpret_cast<char*>(b), 4);
+        return b[0] | (b[1] << 8) | (b[2] << 16) | (uint32_t(b[3]) << 24);
+    }
+
+    static void putString(std::ofstream& out, const std::string& s) {
+        putU32(out, static_cast<uint32_t>(s.size()));
+        out.write(s.data(), static_cast<std::streamsize>(s.size()));
+    }
+
+    static std::string getString(std::ifstream& in) {
+        uint32_t len = getU32(in);
+        if (!in || len > (1u << 20)) {
+            in.setstate(std::ios::failbit);
+            return std::string();
+        }
+        std::string s(len, '\0');
+        in.read(&s[0], len);
+        return s;
+    }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __EXT2FS_INODESET_H__
+#define __EXT2FS_INODESET_H__
+
+#include <stdint.h>
+#include <vector>
+
+/* Membership bitset over the whole inode number space, reused across
+   directories. Only the words touched since the last clear() are reset, so
+   clearing costs as much as the directory that used it. */
+class InodeBitset {
+public:
+    void resize(uint32_t inode_count) {
+        words.assign(inode_count / 64 + 1, 0);
+        touched.clear();
+    }
+
+    void set(uint32_t inode) {
+        size_t w = inode / 64;
+        if (w >= words.size()) return;
+        if (words[w] == 0) touched.push_back(static_cast<uint32_t>(w));
+        words[w] |= uint64_t(1) << (inode % 64);
+    }
+
+    // A word that empties leaves touched too, so a set that is only ever
+    // set/reset as a stack (the recursion path) stays as small as the stack.
+    // The word was usually touched last, so the search starts at the back.
+    void reset(uint32_t inode) {
+        size_t w = inode / 64;
+        if (w >= words.size() || words[w] == 0) return;
+        words[w] &= ~(uint64_t(1) << (inode % 64));
+        if (words[w] != 0) return;
+        for (size_t i = touched.size(); i-- > 0;) {
+            if (touched[i] == w) {
+                touched[i] = touched.back();
+                touched.pop_back();
+                break;
+            }
+        }
+    }
+
+    bool test(uint32_t inode) const {
+        size_t w = inode / 64;
+        return w < words.size() && (words[w] >> (inode % 64)) & 1;
+    }
+
+    void clear() {
+        for (uint32_t w : touched) words[w] = 0;
+        touched.clear();
+    }
+
+private:
+    std::vector<uint64_t> words;
+    std::vector<uint32_t> touched;
+};
+
+#endif
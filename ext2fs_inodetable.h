@@ -0,0 +1,99 @@
+#ifndef __EXT2FS_INODETABLE_H__
+#define __EXT2FS_INODETABLE_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "ext2fs.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define EXT2_INODE_POINTERS (EXT2_NUM_DIRECT_BLOCKS + 3)
+
+/* Struct-of-arrays copy of the inode tables: one contiguous column per field the
+   scan filters on, row = inode number - 1. Block pointers are kept row-major,
+   EXT2_INODE_POINTERS per inode, in i_block order. */
+struct InodeColumns {
+    std::vector<uint16_t> mode;
+    std::vector<uint16_t> link_count;
+    std::vector<uint32_t> size;
+    std::vector<uint32_t> access_time;
+    std::vector<uint32_t> change_time;
+    std::vector<uint32_t> modification_time;
+    std::vector<uint32_t> deletion_time;
+    std::vector<uint32_t> block_ptrs;
+
+    void resize(size_t rows) {
+        mode.assign(rows, 0);
+        link_count.assign(rows, 0);
+        size.assign(rows, 0);
+        access_time.assign(rows, 0);
+        change_time.assign(rows, 0);
+        modification_time.assign(rows, 0);
+        deletion_time.assign(rows, 0);
+        block_ptrs.assign(rows * EXT2_INODE_POINTERS, 0);
+    }
+
+    size_t rows() const { return mode.size(); }
+    const uint32_t* blocks(size_t row) const { return &block_ptrs[row * EXT2_INODE_POINTERS]; }
+
+    /* Decodes count inodes laid out stride bytes apart (one inode-table block
+       or a whole group's table) into rows [row, row + count). */
+    void decode(const char* table, uint32_t count, uint32_t stride, size_t row) {
+        count = static_cast<uint32_t>(std::min<size_t>(count, rows() - std::min(row, rows())));
+        gather16(table, stride, offsetof(ext2_inode, mode), count, &mode[row]);
+        gather16(table, stride, offsetof(ext2_inode, link_count), count, &link_count[row]);
+        gather32(table, stride, offsetof(ext2_inode, size), count, &size[row]);
+        gather32(table, stride, offsetof(ext2_inode, access_time), count, &access_time[row]);
+        gather32(table, stride, offsetof(ext2_inode, change_time), count, &change_time[row]);
+        gather32(table, stride, offsetof(ext2_inode, modification_time), count, &modification_time[row]);
+        gather32(table, stride, offsetof(ext2_inode, deletion_time), count, &deletion_time[row]);
+        // i_block is contiguous inside each inode
+        for (uint32_t i = 0; i < count; i++) {
+            std::memcpy(&block_ptrs[(row + i) * EXT2_INODE_POINTERS],
+                        table + static_cast<size_t>(i) * stride + offsetof(ext2_inode, direct_blocks),
+                        EXT2_INODE_POINTERS * sizeof(uint32_t));
+        }
+    }
+
+    /* out[row] = 1 when no event of the inode can fall in [since, until]: every
+       action lies between its creation (no later than any of its own
+       timestamps) and its latest timestamp. Branch-free over the columns. */
+    void outsideWindow(uint32_t since, uint32_t until, std::vector<uint8_t>& out) const {
+        size_t n = rows();
+        out.resize(n);
+        for (size_t r = 0; r < n; r++) {
+            uint32_t a = access_time[r], c = change_time[r], m = modification_time[r], d = deletion_time[r];
+            uint32_t latest = std::max(std::max(a, c), std::max(m, d));
+            uint32_t earliest = std::min(std::min(a, c), m);
+            out[r] = static_cast<uint8_t>((latest < since) | (earliest > until));
+        }
+    }
+
+private:
+    static void gather32(const char* base, uint32_t stride, size_t offset, uint32_t count, uint32_t* dst) {
+        uint32_t i = 0;
+#if defined(__AVX2__)
+        const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                 _mm256_set1_epi32(static_cast<int>(stride)));
+        for (; i + 8 <= count; i += 8) {
+            const int* p = reinterpret_cast<const int*>(base + static_cast<size_t>(i) * stride + offset);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_i32gather_epi32(p, lanes, 1));
+        }
+#endif
+        for (; i < count; i++) {
+            std::memcpy(dst + i, base + static_cast<size_t>(i) * stride + offset, sizeof(uint32_t));
+        }
+    }
+
+    static void gather16(const char* base, uint32_t stride, size_t offset, uint32_t count, uint16_t* dst) {
+        for (uint32_t i = 0; i < count; i++) {
+            std::memcpy(dst + i, base + static_cast<size_t>(i) * stride + offset, sizeof(uint16_t));
+        }
+    }
+};
+
+#endif
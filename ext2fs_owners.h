@@ -0,0 +1,68 @@
+#ifndef __EXT2FS_OWNERS_H__
+#define __EXT2FS_OWNERS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/* Reverse block map: block number -> live inode that points at it (data or
+   pointer block), plus the block bitmap, one compact array per block group.
+   Owners are relaxed atomics so groups of inodes can be claimed from several
+   threads at once; a block claimed twice keeps whichever claim landed last. */
+class BlockOwners {
+public:
+    BlockOwners(uint32_t block_count, uint32_t first_data_block, uint32_t blocks_per_group, uint32_t group_count)
+        : block_count(block_count), first_data_block(first_data_block), blocks_per_group(blocks_per_group),
+          groups(group_count) {
+        for (uint32_t g = 0; g < group_count; g++) {
+            groups[g].owners = std::make_unique<std::atomic<uint32_t>[]>(blocks_per_group);
+            groups[g].bitmap.assign((blocks_per_group + 7) / 8, 0);
+        }
+    }
+
+    void claim(uint32_t block, uint32_t inode) {
+        uint32_t g, i;
+        if (locate(block, g, i)) groups[g].owners[i].store(inode, std::memory_order_relaxed);
+    }
+
+    uint32_t owner(uint32_t block) const {
+        uint32_t g, i;
+        return locate(block, g, i) ? groups[g].owners[i].load(std::memory_order_relaxed) : 0;
+    }
+
+    // bitmap is the group's on-disk block bitmap block
+    void setBitmap(uint32_t group, const char* bitmap) {
+        if (group < groups.size()) std::memcpy(groups[group].bitmap.data(), bitmap, groups[group].bitmap.size());
+    }
+
+    bool allocated(uint32_t block) const {
+        uint32_t g, i;
+        if (!locate(block, g, i)) return true; // boot block or past the end: never free data
+        return (groups[g].bitmap[i / 8] >> (i % 8)) & 1;
+    }
+
+    // a freed block nobody has reused: neither a live inode's nor allocated
+    bool intact(uint32_t block) const { return owner(block) == 0 && !allocated(block); }
+
+private:
+    struct Group {
+        std::unique_ptr<std::atomic<uint32_t>[]> owners;
+        std::vector<uint8_t> bitmap;
+    };
+
+    uint32_t block_count;
+    uint32_t first_data_block;
+    uint32_t blocks_per_group;
+    std::vector<Group> groups;
+
+    bool locate(uint32_t block, uint32_t& g, uint32_t& i) const {
+        if (block < first_data_block || block >= block_count) return false;
+        g = (block - first_data_block) / blocks_per_group;
+        i = (block - first_data_block) % blocks_per_group;
+        return g < groups.size();
+    }
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef __EXT2FS_PROGRESS_H__
+#define __EXT2FS_PROGRESS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+/* Counters bumped from the scan loops. Relaxed atomics only: the reporter reads
+   approximate values and never synchronizes with the scanner. */
+struct ScanProgress {
+    std::atomic<uint64_t> blocks_scanned{0};
+    std::atomic<uint64_t> inodes_catalogued{0};
+    std::atomic<uint64_t> ghosts_found{0};
+    std::atomic<uint32_t> groups_processed{0};
+    // graph walk: live directories entered, measured against the groups' directory counts
+    std::atomic<uint64_t> dirs_walked{0};
+    // pointers and inode numbers rejected by the range checks, and reads that came up short
+    std::atomic<uint64_t> blocks_rejected{0};
+    std::atomic<uint64_t> inodes_rejected{0};
+    std::atomic<uint64_t> short_reads{0};
+    // --sequential: directory blocks the traversal wanted that streaming did not keep
+    std::atomic<uint64_t> resident_misses{0};
+
+    static void bump(std::atomic<uint64_t>& c, uint64_t n = 1) {
+        c.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+/* Periodically redraws one status line on stderr while a scan runs. */
+class ProgressReporter {
+public:
+    ProgressReporter(const ScanProgress& progress, uint32_t block_size, uint32_t total_blocks,
+                     uint32_t total_groups, uint32_t total_dirs)
+        : progress(progress), block_size(block_size), total_blocks(total_blocks),
+          total_groups(total_groups), total_dirs(total_dirs), start(std::chrono::steady_clock::now()) {
+        worker = std::thread([this] { run(); });
+    }
+
+    ~ProgressReporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+        draw();
+        std::fputc('\n', stderr);
+    }
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+private:
+    const ScanProgress& progress;
+    uint32_t block_size, total_blocks, total_groups, total_dirs;
+    std::chrono::steady_clock::time_point start;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread worker;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, std::chrono::milliseconds(500), [this] { return stopping; })) {
+            draw();
+        }
+    }
+
+    void draw() const {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t blocks = progress.blocks_scanned.load(std::memory_order_relaxed);
+        uint32_t groups = progress.groups_processed.load(std::memory_order_relaxed);
+        uint64_t dirs = progress.dirs_walked.load(std::memory_order_relaxed);
+        double rate = elapsed > 0 ? blocks / elapsed : 0;
+        double mbps = rate * block_size / (1024.0 * 1024.0);
+
+        // the sequential engine reports groups, the graph walk live directories
+        // entered; block reads back up either
+        double done = 0;
+        if (groups > 0 && total_groups > 0) done = static_cast<double>(groups) / total_groups;
+        if (total_dirs > 0 && dirs <= total_dirs) {
+            double by_dirs = static_cast<double>(dirs) / total_dirs;
+            if (by_dirs > done) done = by_dirs;
+        }
+        if (total_blocks > 0 && blocks <= total_blocks) {
+            double by_blocks = static_cast<double>(blocks) / total_blocks;
+            if (by_blocks > done) done = by_blocks;
+        }
+
+        char eta[32];
+        if (done > 0 && done < 1) {
+            std::snprintf(eta, sizeof(eta), "%.0fs", elapsed * (1 - done) / done);
+        } else {
+            std::snprintf(eta, sizeof(eta), "?");
+        }
+        std::fprintf(stderr, "\r[scan] %llu blocks  %.0f blk/s  %.1f MB/s  inodes %llu  ghosts %llu  group %u/%u  dirs %llu/%u  ETA %s   ",
+                     static_cast<unsigned long long>(blocks), rate, mbps,
+                     static_cast<unsigned long long>(progress.inodes_catalogued.load(std::memory_order_relaxed)),
+                     static_cast<unsigned long long>(progress.ghosts_found.load(std::memory_order_relaxed)),
+                     groups, total_groups, static_cast<unsigned long long>(dirs), total_dirs, eta);
+        uint64_t rejected = progress.blocks_rejected.load(std::memory_order_relaxed) +
+                            progress.inodes_rejected.load(std::memory_order_relaxed) +
+                            progress.short_reads.load(std::memory_order_relaxed);
+        if (rejected > 0) {
+            std::fprintf(stderr, "rejected %llu blk/%llu ino/%llu short   ",
+                         static_cast<unsigned long long>(progress.blocks_rejected.load(std::memory_order_relaxed)),
+                         static_cast<unsigned long long>(progress.inodes_rejected.load(std::memory_order_relaxed)),
+                         static_cast<unsigned long long>(progress.short_reads.load(std::memory_order_relaxed)));
+        }
+        uint64_t misses = progress.resident_misses.load(std::memory_order_relaxed);
+        if (misses > 0) {
+            std::fprintf(stderr, "resident misses %llu   ", static_cast<unsigned long long>(misses));
+        }
+        std::fflush(stderr);
+    }
+};
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef __EXT2FS_READER_H__
+#define __EXT2FS_READER_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Linux reads through a file descriptor so it can use pread, posix_fadvise
+   and, where the headers define it, O_DIRECT. Everywhere else (the Windows
+   build included) the image is read through a plain ifstream. */
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define EXT2_POSIX_READER 1
+#ifdef O_DIRECT
+#define EXT2_DIRECT_READER 1
+#endif
+#else
+#include <fstream>
+#endif
+
+#define EXT2_DIRECT_ALIGN 4096
+
+/* Heap buffer aligned for O_DIRECT transfers. */
+class AlignedBuffer {
+public:
+    explicit AlignedBuffer(size_t size) : size_(roundUp(size)) {
+        data_ = static_cast<char*>(::operator new(size_, std::align_val_t(EXT2_DIRECT_ALIGN)));
+    }
+    ~AlignedBuffer() { ::operator delete(data_, std::align_val_t(EXT2_DIRECT_ALIGN)); }
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    char* data() { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    static size_t roundUp(size_t n) { return (n + EXT2_DIRECT_ALIGN - 1) & ~size_t(EXT2_DIRECT_ALIGN - 1); }
+
+private:
+    char* data_;
+    size_t size_;
+};
+
+/* Free list of aligned buffers; the scan is single threaded, so a buffer goes
+   back to the pool as soon as its read has been copied out. */
+class AlignedBufferPool {
+public:
+    std::unique_ptr<AlignedBuffer> acquire(size_t size) {
+        for (size_t i = 0; i < free_list.size(); i++) {
+            if (free_list[i]->size() >= size) {
+                std::unique_ptr<AlignedBuffer> buf = std::move(free_list[i]);
+                free_list.erase(free_list.begin() + i);
+                return buf;
+            }
+        }
+        return std::make_unique<AlignedBuffer>(size);
+    }
+
+    void release(std::unique_ptr<AlignedBuffer> buf) {
+        if (buf) free_list.push_back(std::move(buf));
+    }
+
+private:
+    std::vector<std::unique_ptr<AlignedBuffer>> free_list;
+};
+
+/* Positional reads from an image file or block device.
+
+   Buffered mode goes through the page cache. On Linux it also passes fadvise
+   hints: random access while walking the tree, sequential plus DONTNEED behind
+   the cursor while streaming, so a full scan does not push the rest of the
+   machine's cache out. Elsewhere the hints are no-ops.
+
+   Direct mode exists only where O_DIRECT does. Asked for or implied by a block
+   device, it opens with O_DIRECT and reads whole aligned spans into pooled
+   buffers. If the kernel or filesystem refuses O_DIRECT (open fails, or a read
+   returns EINVAL because the device wants a larger alignment), the reader
+   reopens the file buffered and carries on. */
+class ImageReader {
+public:
+    ImageReader() = default;
+    ImageReader(const ImageReader&) = delete;
+    ImageReader& operator=(const ImageReader&) = delete;
+    ~ImageReader() { close(); }
+
+    bool open(const std::string& filename, bool want_direct) {
+        path = filename;
+#ifdef EXT2_POSIX_READER
+        struct stat st;
+        block_device = ::stat(filename.c_str(), &st) == 0 && S_ISBLK(st.st_mode);
+#endif
+        if ((want_direct || block_device) && openDirect()) return true;
+        return openBuffered();
+    }
+
+    void close() {
+#ifdef EXT2_POSIX_READER
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#else
+        if (file.is_open()) file.close();
+#endif
+    }
+
+    bool isOpen() const {
+#ifdef EXT2_POSIX_READER
+        return fd >= 0;
+#else
+        return file.is_open();
+#endif
+    }
+    bool isDirect() const { return direct; }
+    bool isBlockDevice() const { return block_device; }
+    const std::string& filename() const { return path; }
+
+    /* Reads up to len bytes at offset; returns the count actually read, which
+       is short only at end of image or on an I/O error. */
+    size_t readAt(uint64_t offset, void* dst, size_t len) {
+#ifdef EXT2_DIRECT_READER
+        if (direct) {
+            ssize_t n = readDirect(offset, static_cast<char*>(dst), len);
+            if (n >= 0) return static_cast<size_t>(n);
+            // alignment rejected: drop to the page cache for the rest of the run
+            if (!openBuffered()) return 0;
+        }
+#endif
+        return readBuffered(offset, static_cast<char*>(dst), len);
+    }
+
+    void adviseSequential() {
+#ifdef EXT2_POSIX_READER
+        if (!direct) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    void adviseRandom() {
+#ifdef EXT2_POSIX_READER
+        if (!direct) posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+    }
+
+    // blocks a walk is about to need; the page cache starts reading them now
+    void prefetch(uint64_t offset, uint64_t len) {
+#ifdef EXT2_POSIX_READER
+        if (!direct) posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(len), POSIX_FADV_WILLNEED);
+#else
+        (void)offset, (void)len;
+#endif
+    }
+
+    // pages already consumed by a streaming pass will not be read again
+    void dropCached(uint64_t offset, uint64_t len) {
+#ifdef EXT2_POSIX_READER
+        if (!direct) posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(len), POSIX_FADV_DONTNEED);
+#else
+        (void)offset, (void)len;
+#endif
+    }
+
+private:
+#ifdef EXT2_POSIX_READER
+    int fd = -1;
+#else
+    std::ifstream file;
+#endif
+    bool direct = false;
+    bool block_device = false;
+    std::string path;
+
+    bool openDirect() {
+#ifdef EXT2_DIRECT_READER
+        close();
+        fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+        direct = fd >= 0;
+        return direct;
+#else
+        return false;
+#endif
+    }
+
+#ifdef EXT2_POSIX_READER
+    bool openBuffered() {
+        close();
+        direct = false;
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+        return true;
+    }
+
+    size_t readBuffered(uint64_t offset, char* dst, size_t len) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::pread(fd, dst + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            done += static_cast<size_t>(n);
+        }
+        return done;
+    }
+#else
+    bool openBuffered() {
+        close();
+        direct = false;
+        file.open(path, std::ios::binary);
+        return file.is_open();
+    }
+
+    size_t readBuffered(uint64_t offset, char* dst, size_t len) {
+        // a short read at the image end sets failbit; clear it so the next read is not lost
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(dst, static_cast<std::streamsize>(len));
+        size_t done = static_cast<size_t>(file.gcount());
+        file.clear();
+        return done;
+    }
+#endif
+
+#ifdef EXT2_DIRECT_READER
+    AlignedBufferPool pool;
+
+    // -1 when the device rejects the transfer as misaligned
+    ssize_t readDirect(uint64_t offset, char* dst, size_t len) {
+        if (reinterpret_cast<uintptr_t>(dst) % EXT2_DIRECT_ALIGN == 0 && offset % EXT2_DIRECT_ALIGN == 0 &&
+            len % EXT2_DIRECT_ALIGN == 0) {
+            return readAligned(offset, dst, len);
+        }
+        uint64_t start = offset & ~uint64_t(EXT2_DIRECT_ALIGN - 1);
+        size_t lead = static_cast<size_t>(offset - start);
+        size_t span = AlignedBuffer::roundUp(lead + len);
+        std::unique_ptr<AlignedBuffer> buf = pool.acquire(span);
+
+        ssize_t got = readAligned(start, buf->data(), span);
+        if (got < 0) {
+            pool.release(std::move(buf));
+            return -1;
+        }
+        size_t useful = static_cast<size_t>(got) > lead ? std::min(static_cast<size_t>(got) - lead, len) : 0;
+        std::memcpy(dst, buf->data() + lead, useful);
+        pool.release(std::move(buf));
+        return static_cast<ssize_t>(useful);
+    }
+
+    ssize_t readAligned(uint64_t offset, char* dst, size_t len) {
+        size_t got = 0;
+        while (got < len) {
+            ssize_t n = ::pread(fd, dst + got, len - got, static_cast<off_t>(offset + got));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EINVAL) return -1;
+            if (n <= 0) break;
+            got += static_cast<size_t>(n);
+            if (got % EXT2_DIRECT_ALIGN) break; // end of file
+        }
+        return static_cast<ssize_t>(got);
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __EXT2FS_RESULT_H__
+#define __EXT2FS_RESULT_H__
+
+#include <stdint.h>
+#include <utility>
+
+/* Why a block or inode read produced nothing. Damaged images and carved ghost
+   pointers hit these constantly, so they are values rather than exceptions. */
+enum class ReadStatus : uint8_t {
+    Ok,
+    BlockOutOfRange,  /* block number >= s_blocks_count, rejected before any I/O */
+    InodeOutOfRange,  /* inode number > s_inodes_count, rejected before any I/O */
+    ShortRead,        /* in range, but the image ended or the read failed */
+};
+
+inline const char* readStatusName(ReadStatus status) {
+    switch (status) {
+    case ReadStatus::Ok: return "ok";
+    case ReadStatus::BlockOutOfRange: return "block out of range";
+    case ReadStatus::InodeOutOfRange: return "inode out of range";
+    case ReadStatus::ShortRead: return "short read";
+    }
+    return "?";
+}
+
+/* A value or the ReadStatus explaining its absence. */
+template <class T>
+class ReadResult {
+public:
+    ReadResult(T value) : value_(std::move(value)), status_(ReadStatus::Ok) {}
+    ReadResult(ReadStatus status) : value_(), status_(status) {}
+
+    bool ok() const { return status_ == ReadStatus::Ok; }
+    explicit operator bool() const { return ok(); }
+    ReadStatus status() const { return status_; }
+
+    T& value() { return value_; }
+    const T& value() const { return value_; }
+    const T* operator->() const { return &value_; }
+    T take() { return std::move(value_); }
+
+private:
+    T value_;
+    ReadStatus status_;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef __EXT2FS_TIMEINDEX_H__
+#define __EXT2FS_TIMEINDEX_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/* (timestamp, inode) pairs sorted once, then queried by binary search. Zero
+   timestamps are never stored: they mean "not set". */
+class TimestampIndex {
+public:
+    using Entry = std::pair<uint32_t, uint32_t>;
+    using Range = std::pair<std::vector<Entry>::const_iterator, std::vector<Entry>::const_iterator>;
+
+    void add(uint32_t time, uint32_t inode) {
+        if (time != 0) entries.push_back({time, inode});
+    }
+
+    void seal() {
+        std::sort(entries.begin(), entries.end());
+        entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    }
+
+    Range at(uint32_t time) const {
+        return std::equal_range(entries.begin(), entries.end(), Entry{time, 0},
+                                [](const Entry& a, const Entry& b) { return a.first < b.first; });
+    }
+
+    // true when every inode stamped at time is the given one
+    bool onlyInode(uint32_t time, uint32_t inode) const {
+        Range r = at(time);
+        if (r.first == r.second) return false;
+        for (auto it = r.first; it != r.second; ++it) {
+            if (it->second != inode) return false;
+        }
+        return true;
+    }
+
+    // the single inode stamped at time other than the excluded ones, or 0
+    uint32_t soleInode(uint32_t time, uint32_t exclude_a, uint32_t exclude_b = 0) const {
+        uint32_t found = 0;
+        Range r = at(time);
+        for (auto it = r.first; it != r.second; ++it) {
+            if (it->second == exclude_a || it->second == exclude_b) continue;
+            if (found != 0) return 0;
+            found = it->second;
+        }
+        return found;
+    }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    std::vector<Entry> entries;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef __EXT2FS_TIMELINE_H__
+#define __EXT2FS_TIMELINE_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ext2fs_history.h"
+#include "ext2fs_versions.h"
+
+/* The recovered history as one time-sorted event log, replayed into a tree to
+   show the filesystem as it was at a given moment, or into persistent versions
+   to compare two moments. Events without a timestamp
+   cannot be placed and are left out; an event with an unknown endpoint still
+   applies what it knows (an inode moved to an unknown place leaves the tree). */
+class Timeline {
+public:
+    void add(const Action& action, bool is_dir) {
+        if (action.timestamp == 0 || action.affected_inodes.empty()) return;
+        Event e;
+        e.timestamp = action.timestamp;
+        e.kind = actionRank(action.action);
+        e.inode = action.affected_inodes[0];
+        e.is_dir = is_dir;
+        e.dir = action.affected_dirs.empty() ? 0 : action.affected_dirs.back();
+        e.name = action.args.empty() ? std::string() : baseName(action.args.back());
+        events.push_back(std::move(e));
+    }
+
+    // Ties within one second replay creations first and removals last.
+    void seal() {
+        std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.kind < b.kind;
+        });
+    }
+
+    size_t size() const { return events.size(); }
+
+    /* One rendering per requested time, in the order given. The queries are
+       answered in ascending time over a single forward replay, so the whole
+       batch costs one pass over the log plus the renderings. */
+    std::vector<std::string> render(const std::vector<uint32_t>& times, uint32_t root,
+                                    const std::string& root_name) {
+        std::vector<size_t> order(times.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return times[a] < times[b]; });
+
+        std::vector<std::string> out(times.size());
+        reset(root, root_name);
+        size_t cursor = 0;
+        for (size_t q : order) {
+            for (; cursor < events.size() && events[cursor].timestamp <= times[q]; cursor++) {
+                apply(events[cursor]);
+            }
+            std::ostringstream text;
+            draw(text, root, 1);
+            out[q] = text.str();
+        }
+        return out;
+    }
+
+    /* Inodes added, removed and moved between t1 and t2, one line each in
+       history style, ascending by inode. Paths are resolved under root, whose
+       own path is root_path; an inode whose chain does not reach root counts as
+       absent. Checkpoint versions are built on first use and shared by later
+       calls, so each diff costs at most two short replays plus the changes. */
+    std::string diff(uint32_t t1, uint32_t t2, uint32_t root, const std::string& root_path) {
+        buildCheckpoints();
+        PlacementVersions::Root a = versionAt(t1), b = versionAt(t2);
+        std::ostringstream out;
+        versions->diff(a, b, [&](uint32_t inode, Placement, Placement) {
+            std::string before, after;
+            bool was = pathIn(a, inode, root, root_path, before);
+            bool is = pathIn(b, inode, root, root_path, after);
+            if (was && is && before != after) out << "moved [" << before << " " << after << "] [" << inode << "]\n";
+            else if (!was && is) out << "added [" << after << "] [" << inode << "]\n";
+            else if (was && !is) out << "removed [" << before << "] [" << inode << "]\n";
+        });
+        return out.str();
+    }
+
+private:
+    enum Rank : uint8_t { MKDIR, TOUCH, MV, RM, RMDIR }; // values of actionRank()
+
+    struct Event {
+        uint32_t timestamp;
+        uint8_t kind;
+        uint32_t inode;
+        bool is_dir;
+        uint32_t dir;      // directory the inode ends up in (or leaves, for rm), 0 if unknown
+        std::string name;  // its name there, empty if unknown
+    };
+
+    // Children form an intrusive doubly linked list in arrival order, so
+    // attach and detach are O(1) and listings keep directory-append order.
+    struct Node {
+        std::string name;
+        bool is_dir = false;
+        uint32_t parent = 0;
+        uint32_t first_child = 0, last_child = 0;
+        uint32_t prev = 0, next = 0;
+    };
+
+    // a persistent version is kept after every CHECKPOINT_EVENTS events
+    static const size_t CHECKPOINT_EVENTS = 64;
+
+    std::vector<Event> events;
+    std::unordered_map<uint32_t, Node> nodes;
+    std::unique_ptr<PlacementVersions> versions;
+    std::vector<PlacementVersions::Root> checkpoints; // [k] = state after k * CHECKPOINT_EVENTS events
+    std::vector<std::string> names;                   // name ids of Placement; 0 is "?"
+    std::unordered_map<std::string, uint32_t> name_ids;
+
+    static std::string baseName(const std::string& path) {
+        if (path.empty() || path == "?") return std::string();
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    void reset(uint32_t root, const std::string& root_name) {
+        nodes.clear();
+        Node& r = nodes[root];
+        r.name = root_name;
+        r.is_dir = true;
+    }
+
+    void detach(uint32_t inode) {
+        Node& n = nodes[inode];
+        if (n.parent == 0) return;
+        Node& p = nodes[n.parent];
+        if (n.prev) nodes[n.prev].next = n.next; else p.first_child = n.next;
+        if (n.next) nodes[n.next].prev = n.prev; else p.last_child = n.prev;
+        n.parent = n.prev = n.next = 0;
+    }
+
+    void attach(uint32_t inode, uint32_t dir, const std::string& name) {
+        detach(inode);
+        Node& p = nodes[dir];
+        p.is_dir = true;
+        Node& n = nodes[inode];
+        n.name = name.empty() ? "?" : name;
+        n.parent = dir;
+        n.prev = p.last_child;
+        if (p.last_child) nodes[p.last_child].next = inode; else p.first_child = inode;
+        p.last_child = inode;
+    }
+
+    void apply(const Event& e) {
+        nodes[e.inode].is_dir = e.is_dir;
+        switch (e.kind) {
+        case MKDIR:
+        case TOUCH:
+        case MV:
+            if (e.dir != 0 && e.dir != e.inode) attach(e.inode, e.dir, e.name);
+            else detach(e.inode);
+            break;
+        case RM:
+        case RMDIR:
+            detach(e.inode);
+            break;
+        }
+    }
+
+    uint32_t nameId(const std::string& name) {
+        if (names.empty()) names.push_back("?");
+        if (name.empty()) return 0;
+        auto it = name_ids.emplace(name, static_cast<uint32_t>(names.size())).first;
+        if (it->second == names.size()) names.push_back(name);
+        return it->second;
+    }
+
+    Placement placementOf(const Event& e) {
+        if ((e.kind == RM || e.kind == RMDIR) || e.dir == 0 || e.dir == e.inode) return Placement{};
+        return Placement{e.dir, nameId(e.name)};
+    }
+
+    void buildCheckpoints() {
+        if (versions) return;
+        uint32_t max_inode = 0;
+        for (const Event& e : events) max_inode = std::max(max_inode, std::max(e.inode, e.dir));
+        versions = std::make_unique<PlacementVersions>(max_inode);
+        PlacementVersions::Root current;
+        checkpoints.push_back(current);
+        for (size_t i = 0; i < events.size(); i++) {
+            current = versions->set(current, events[i].inode, placementOf(events[i]));
+            if ((i + 1) % CHECKPOINT_EVENTS == 0) checkpoints.push_back(current);
+        }
+    }
+
+    // the version after every event up to and including time t
+    PlacementVersions::Root versionAt(uint32_t t) {
+        size_t count = std::upper_bound(events.begin(), events.end(), t, [](uint32_t time, const Event& e) {
+            return time < e.timestamp;
+        }) - events.begin();
+        size_t k = count / CHECKPOINT_EVENTS;
+        PlacementVersions::Root version = checkpoints[k];
+        for (size_t i = k * CHECKPOINT_EVENTS; i < count; i++) {
+            version = versions->set(version, events[i].inode, placementOf(events[i]));
+        }
+        return version;
+    }
+
+    bool pathIn(const PlacementVersions::Root& version, uint32_t inode, uint32_t root,
+                const std::string& root_path, std::string& out) const {
+        std::vector<uint32_t> chain;
+        for (uint32_t cur = inode; cur != root; ) {
+            Placement p = versions->get(version, cur);
+            // bounded so a corrupt parent loop cannot spin
+            if (p.parent == 0 || chain.size() > events.size()) return false;
+            chain.push_back(p.name);
+            cur = p.parent;
+        }
+        if (chain.empty()) return false;
+        out = root_path;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) out += "/" + names[*it];
+        return true;
+    }
+
+    void draw(std::ostringstream& out, uint32_t inode, int depth) {
+        const Node& n = nodes[inode];
+        out << std::string(depth, '-') << " " << inode << ":" << n.name << (n.is_dir ? "/" : "") << "\n";
+        for (uint32_t c = n.first_child; c != 0; c = nodes[c].next) {
+            draw(out, c, depth + 1);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef __EXT2FS_VERSIONS_H__
+#define __EXT2FS_VERSIONS_H__
+
+#include <stdint.h>
+#include <array>
+#include <memory>
+
+/* Where an inode sits in one version of the tree: its directory and an id for
+   its name there. parent 0 means it is not in the tree. */
+struct Placement {
+    uint32_t parent = 0;
+    uint32_t name = 0;
+
+    bool operator==(const Placement& o) const { return parent == o.parent && name == o.name; }
+    bool operator!=(const Placement& o) const { return !(*this == o); }
+};
+
+/* Persistent inode -> Placement map: a fixed-height 16-way trie over the inode
+   number whose updates copy only the path to the changed leaf, so every version
+   stays valid and unchanged subtrees are shared between versions. Two versions
+   are compared by walking both tries and skipping any subtree they share, which
+   costs the number of differing inodes times the height, not the map size.
+   Inner levels are Interior nodes and the bottom level Leaf nodes; the level
+   alone says which one a pointer is. */
+class PlacementVersions {
+public:
+    struct Node {};
+    using Root = std::shared_ptr<const Node>;
+
+    struct Interior : Node {
+        std::array<Root, 16> kids;
+    };
+    struct Leaf : Node {
+        std::array<Placement, 16> slots;
+    };
+
+    // height is picked so that every inode number up to max_inode has a leaf
+    explicit PlacementVersions(uint32_t max_inode) {
+        while (height < 8 && (max_inode >> (4 * height)) != 0) height++;
+        if (height == 0) height = 1;
+    }
+
+    Placement get(const Root& root, uint32_t inode) const {
+        const Node* node = root.get();
+        for (int level = height - 1; node && level > 0; level--) {
+            node = interior(node)->kids[digit(inode, level)].get();
+        }
+        return node ? leaf(node)->slots[digit(inode, 0)] : Placement{};
+    }
+
+    Root set(const Root& root, uint32_t inode, Placement value) const {
+        return setAt(root.get(), inode, value, height - 1);
+    }
+
+    // visit(inode, before, after) for every inode placed differently, ascending
+    template <class Visit>
+    void diff(const Root& a, const Root& b, Visit&& visit) const {
+        diffAt(a.get(), b.get(), height - 1, 0, visit);
+    }
+
+private:
+    int height = 0;
+
+    static uint32_t digit(uint32_t inode, int level) { return (inode >> (4 * level)) & 0xF; }
+
+    static const Interior* interior(const Node* node) { return static_cast<const Interior*>(node); }
+    static const Leaf* leaf(const Node* node) { return static_cast<const Leaf*>(node); }
+
+    Root setAt(const Node* node, uint32_t inode, Placement value, int level) const {
+        uint32_t d = digit(inode, level);
+        if (level == 0) {
+            auto copy = node ? std::make_shared<Leaf>(*leaf(node)) : std::make_shared<Leaf>();
+            copy->slots[d] = value;
+            return copy;
+        }
+        auto copy = node ? std::make_shared<Interior>(*interior(node)) : std::make_shared<Interior>();
+        copy->kids[d] = setAt(copy->kids[d].get(), inode, value, level - 1);
+        return copy;
+    }
+
+    template <class Visit>
+    void diffAt(const Node* a, const Node* b, int level, uint32_t prefix, Visit& visit) const {
+        if (a == b) return;
+        if (level == 0) {
+            static const Leaf empty{};
+            const Leaf& x = a ? *leaf(a) : empty;
+            const Leaf& y = b ? *leaf(b) : empty;
+            for (uint32_t d = 0; d < 16; d++) {
+                if (x.slots[d] != y.slots[d]) visit(prefix | d, x.slots[d], y.slots[d]);
+            }
+            return;
+        }
+        static const Interior empty{};
+        const Interior& x = a ? *interior(a) : empty;
+        const Interior& y = b ? *interior(b) : empty;
+        for (uint32_t d = 0; d < 16; d++) {
+            diffAt(x.kids[d].get(), y.kids[d].get(), level - 1, prefix | (d << (4 * level)), visit);
+        }
+    }
+};
+
+#endif
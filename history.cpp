@@ -3,21 +3,64 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <cstdlib>
 #include <memory>
 #include <stdexcept>
 #include <map>
+#include <unordered_map>
+#include <string_view>
+#include <memory_resource>
 #include <set>
+#include <sstream>
 #include "ext2fs.h"
 #include "ext2fs_print.h"
+#include "ext2fs_geometry.h"
+#include "ext2fs_progress.h"
+#include "ext2fs_arena.h"
+#include "ext2fs_inodeset.h"
+#include "ext2fs_index.h"
+#include "ext2fs_history.h"
+#include "ext2fs_arrow.h"
+#include "ext2fs_hash.h"
+#include "ext2fs_reader.h"
+#include "ext2fs_blockmap.h"
+#include "ext2fs_result.h"
+#include "ext2fs_inodetable.h"
+#include "ext2fs_timeindex.h"
+#include "ext2fs_timeline.h"
+#include "ext2fs_compare.h"
+#include "ext2fs_extract.h"
+#include "ext2fs_owners.h"
+#include <filesystem>
+#include <unordered_set>
 #include <algorithm>
+#include <future>
 using namespace std;
 
+// Decimal digits only, no sign or spaces, and the value must fit in 32 bits.
+bool parseUint32(const string& text, uint32_t& value) {
+    if (text.empty() || text.size() > 10 || text.find_first_not_of("0123456789") != string::npos) {
+        return false;
+    }
+    uint64_t parsed = std::stoull(text);
+    if (parsed > UINT32_MAX) return false;
+    value = static_cast<uint32_t>(parsed);
+    return true;
+}
+
+// name points into the directory block being parsed, then into the listing cache
 struct GhostEntry {
     uint32_t inode;
-    string name;
+    std::string_view name;
     uint8_t file_type;
 };
 
+struct LiveEntry {
+    uint32_t inode;
+    std::string_view name;
+    bool is_dir;
+};
+
 struct EntryRecord {
     string full_path;
     string name;
@@ -37,56 +80,557 @@ struct Info {
     bool foundCreation, foundDeletion, foundOtherGhost;
 };
 
+// Allocator-aware so the catalog map hands its arena down to the entry lists.
 struct InodeRecord {
+    using allocator_type = std::pmr::polymorphic_allocator<EntryRecord>;
     ext2_inode inode_data;
-    vector<EntryRecord> entries;
-};
+    std::pmr::vector<EntryRecord> entries;
 
-struct Action {
-    uint32_t timestamp;
-    std::string action;
-    std::vector<std::string> args;
-    std::vector<uint32_t> affected_dirs;
-    std::vector<uint32_t> affected_inodes;
+    InodeRecord() : inode_data{} {}
+    explicit InodeRecord(const allocator_type& alloc) : inode_data{}, entries(alloc) {}
+    InodeRecord(const InodeRecord& other) = default;
+    InodeRecord(const InodeRecord& other, const allocator_type& alloc)
+        : inode_data(other.inode_data), entries(other.entries, alloc) {}
+    InodeRecord(InodeRecord&& other, const allocator_type& alloc)
+        : inode_data(other.inode_data), entries(std::move(other.entries), alloc) {}
 };
 
+
 class Ext2FileSystem {
 private:
-    std::ifstream fs_file;
+    ImageReader image;
     ext2_super_block super_block;
     vector<ext2_block_group_descriptor> bgd_table;
     uint32_t block_size;
     uint32_t num_block_groups;
-    map<uint32_t, InodeRecord> inode_to_info;
+    Ext2Geometry geometry;
+    // catalog nodes and entry lists live until the filesystem object goes away
+    std::pmr::monotonic_buffer_resource catalog_arena{1 << 16};
+    std::pmr::map<uint32_t, InodeRecord> inode_to_info{&catalog_arena};
+    ScanArenaStack block_arenas;
+    InodeBitset live_inodes;
+
+    // filled by streamImage(): every inode from the inode tables and every block
+    // owned by a directory inode, so traversal runs without touching the image
+    bool image_resident = false;
+    vector<ext2_inode> inode_catalog;
+    InodeColumns inode_columns;
+    unordered_map<uint32_t, vector<char>> resident_blocks;
+    ScanProgress progress;
+    uint32_t scope_inode = EXT2_ROOT_INODE;
+    string scope_path;
+    string scope_name = "root";
+    // --since/--until; inodes and directories outside it are dropped during the scan
+    bool windowed = false;
+    uint32_t window_since = 0;
+    uint32_t window_until = UINT32_MAX;
+    InodeBitset pruned_inodes;
+    HistoryFormat history_format = HistoryFormat::Text;
+    std::unique_ptr<BlockHashLedger> ledger;
+    // endpoint resolution: built lazily from the inode tables
+    bool time_index_built = false;
+    TimestampIndex dir_times;
+    TimestampIndex inode_times;
+    std::unordered_map<uint32_t, ext2_inode> inference_inodes;
+    std::unordered_map<uint32_t, string> resolved_paths;
+    // inferred once, shared by the history output and --at renderings
+    bool actions_collected = false;
+    vector<Action> recovered_actions;
+    std::unique_ptr<Timeline> timeline;
+    // --intact: who owns each block now, built on the first rm/rmdir to annotate
+    bool track_intact = false;
+    std::unique_ptr<BlockOwners> owners;
 
 public:
-    explicit Ext2FileSystem(const std::string& filename) {
-        fs_file.open(filename, std::ios::binary);
-        if (!fs_file.is_open()) {
+    // direct_io bypasses the page cache; block devices always get it
+    explicit Ext2FileSystem(const std::string& filename, bool direct_io = false) {
+        if (!image.open(filename, direct_io)) {
             throw std::runtime_error("Failed to open filesystem image: " + filename);
         }
         readSuperBlock();
         readBGDTable();
+        live_inodes.resize(super_block.inode_count);
+        pruned_inodes.resize(super_block.inode_count);
+        on_path.resize(super_block.inode_count);
+        walked_dirs.resize(super_block.inode_count);
     }
     
-    ~Ext2FileSystem() {
-        if (fs_file.is_open()) {
-            fs_file.close();
-        }
+    const ScanProgress& scanProgress() const { return progress; }
+    uint32_t blockSize() const { return block_size; }
+    uint32_t blockCount() const { return super_block.block_count; }
+    uint32_t groupCount() const { return num_block_groups; }
+    uint32_t directoryCount() const {
+        uint32_t dirs = 0;
+        for (const auto& bgd : bgd_table) dirs += bgd.used_dirs_count;
+        return dirs;
     }
+    uint32_t inodesPerGroup() const { return super_block.inodes_per_group; }
+
+    bool directIO() const { return image.isDirect(); }
     
     void displayDirectoryTree() {
-        traverseDirectory(EXT2_ROOT_INODE, 1, "", "root", false);
+        traverseDirectory(scope_inode, 1, scope_path, scope_name, false);
+    }
+
+    // Hash every block read from here on. The superblock and descriptor blocks
+    // were read before the ledger existed, so they are read once more through it.
+    void enableReadManifest() {
+        ledger = std::make_unique<BlockHashLedger>(super_block.block_count, super_block.first_data_block,
+                                                   super_block.blocks_per_group, num_block_groups);
+        uint32_t bgd_blocks = (num_block_groups * sizeof(ext2_block_group_descriptor) + block_size - 1) / block_size;
+        readBlock(EXT2_SUPER_BLOCK_POSITION / block_size);
+        for (uint32_t b = 0; b < bgd_blocks; b++) {
+            readBlock(super_block.first_data_block + 1 + b);
+        }
+    }
+
+    void writeReadManifest(const string& filename, const string& image) const {
+        if (ledger) ledger->writeManifest(filename, image, block_size);
+    }
+
+    void setHistoryFormat(HistoryFormat format) {
+        history_format = format;
+    }
+
+    void enableIntactTracking() {
+        track_intact = true;
+    }
+
+    void setTimeWindow(uint32_t since, uint32_t until) {
+        windowed = true;
+        window_since = since;
+        window_until = until;
+        if (image_resident) pruneOutsideWindow();
+    }
+
+    // Limits the state tree and the history to one directory subtree, given as
+    // an absolute path or a directory inode number. Paths still print absolute.
+    void setScope(const string& spec) {
+        std::unordered_map<uint32_t, string> path_cache;
+        uint32_t inode_num = EXT2_ROOT_INODE;
+        string path;
+        if (!spec.empty() && spec.find_first_not_of("0123456789") == string::npos) {
+            if (!parseUint32(spec, inode_num) || inode_num == 0 || !inodeInRange(inode_num)) {
+                throw std::runtime_error("No such inode: " + spec);
+            }
+            if (!(readInode(inode_num).mode & EXT2_I_DTYPE)) {
+                throw std::runtime_error("Not a directory: " + spec);
+            }
+            path = directoryPath(inode_num, 0, path_cache);
+        } else {
+            std::stringstream components(spec);
+            string name;
+            while (std::getline(components, name, '/')) {
+                if (name.empty()) continue;
+                inode_num = findChildDirectory(inode_num, name);
+                path = joinPath(path, name);
+                if (!inodeInRange(inode_num) || !(readInode(inode_num).mode & EXT2_I_DTYPE)) {
+                    throw std::runtime_error("Not a directory: /" + path);
+                }
+            }
+        }
+        scope_inode = inode_num;
+        scope_path = path == "?" ? "" : path;
+        size_t slash = scope_path.rfind('/');
+        scope_name = scope_path.empty() ? (inode_num == EXT2_ROOT_INODE ? "root" : std::to_string(inode_num))
+                                        : scope_path.substr(slash == string::npos ? 0 : slash + 1);
     }
     void recovery(){
         printRecoveredActions();
     }
 
+    // One group's inode table and the live entries of its in-use directories,
+    // read straight from the image with nothing cached between groups.
+    GroupCatalog catalogGroup(uint32_t group) {
+        GroupCatalog catalog;
+        catalog.first_inode = group * super_block.inodes_per_group + 1;
+        uint32_t per_block = geometry.inodesPerBlock();
+        uint32_t table_blocks = (super_block.inodes_per_group + per_block - 1) / per_block;
+        catalog.columns.resize(super_block.inodes_per_group);
+        for (uint32_t tb = 0; tb < table_blocks; tb++) {
+            auto table = fetchBlock(bgd_table[group].inode_table + tb);
+            if (!table) continue;
+            uint32_t first = tb * per_block;
+            uint32_t count = std::min(per_block, super_block.inodes_per_group - first);
+            catalog.columns.decode(table.value().data(), count, geometry.inode_size, first);
+        }
+        for (size_t r = 0; r < catalog.columns.rows(); r++) {
+            if (!(catalog.columns.mode[r] & EXT2_I_DTYPE) || !catalogInUse(catalog.columns, r)) continue;
+            ext2_inode dir{};
+            const uint32_t* ptrs = catalog.columns.blocks(r);
+            for (int k = 0; k < EXT2_NUM_DIRECT_BLOCKS; k++) dir.direct_blocks[k] = ptrs[k];
+            dir.single_indirect = ptrs[EXT2_NUM_DIRECT_BLOCKS];
+            dir.double_indirect = ptrs[EXT2_NUM_DIRECT_BLOCKS + 1];
+            dir.triple_indirect = ptrs[EXT2_NUM_DIRECT_BLOCKS + 2];
+            vector<vector<char>> blocks;
+            collectDirectoryBlocks(dir, blocks);
+            std::pmr::monotonic_buffer_resource arena;
+            DirectoryListing listing(&arena);
+            parseDirectory(blocks, listing);
+            DirentSet set;
+            set.dir = catalog.first_inode + static_cast<uint32_t>(r);
+            for (const auto& live : listing.live) {
+                if (live.name == "." || live.name == "..") continue;
+                set.entries.push_back({string(live.name), live.inode});
+            }
+            std::sort(set.entries.begin(), set.entries.end());
+            catalog.dirs.push_back(std::move(set));
+        }
+        return catalog;
+    }
+
+    // The scoped tree as it stood at each of the given times, one rendering per
+    // time, replayed from the recovered history. Needs a prior traversal.
+    vector<string> treesAt(const vector<uint32_t>& times) {
+        return eventLog().render(times, scope_inode, scope_name);
+    }
+
+    // What was added, removed or moved in the scoped tree between two times.
+    string diffBetween(uint32_t t1, uint32_t t2) {
+        return eventLog().diff(t1, t2, scope_inode, scope_path);
+    }
+
+    Timeline& eventLog() {
+        if (!timeline) {
+            timeline = std::make_unique<Timeline>();
+            for (const auto& action : recoveredActions()) {
+                bool is_dir = false;
+                if (!action.affected_inodes.empty()) {
+                    auto it = inode_to_info.find(action.affected_inodes[0]);
+                    is_dir = it != inode_to_info.end() && (it->second.inode_data.mode & EXT2_I_DTYPE);
+                }
+                timeline->add(action, is_dir);
+            }
+            timeline->seal();
+        }
+        return *timeline;
+    }
+
+    // History of a handful of inodes without walking the tree. Their entries come
+    // from a saved dirent index when one is given; otherwise one sweep over the
+    // directory inodes picks out just the requested numbers.
+    void recoverInodes(const vector<uint32_t>& targets, const DirentIndex* index) {
+        std::set<uint32_t> wanted;
+        for (uint32_t inode_num : targets) {
+            auto inode_data = fetchInode(inode_num);
+            if (!inode_data) {
+                std::cerr << "Skipping inode " << inode_num << ": " << readStatusName(inode_data.status()) << "\n";
+                continue;
+            }
+            inode_to_info[inode_num].inode_data = inode_data.value();
+            wanted.insert(inode_num);
+        }
+
+        if (index) {
+            for (uint32_t inode_num : wanted) {
+                for (uint32_t idx : index->lookupInode(inode_num)) {
+                    const DirentRecord& r = index->at(idx);
+                    inode_to_info[inode_num].entries.push_back({r.full_path, r.name, r.parent_inode, r.is_ghost});
+                }
+            }
+        } else {
+            sweepDirectoriesFor(wanted);
+        }
+
+        vector<Action> actions;
+        for (const auto& [inode, record] : inode_to_info) {
+            collectActions(inode, record, actions);
+        }
+        emitActions(actions);
+    }
+
+    // Writes the mapped contents of deleted regular files (every regular file
+    // with all) into dir as <inode>[_<name>]. The block maps are walked here,
+    // single threaded; only the data copy runs in parallel. Returns how many
+    // files had something to recover and how many of those were written in full.
+    std::pair<size_t, size_t> extractFiles(const string& dir, bool all, const string& image_path) {
+        std::filesystem::create_directories(dir);
+        vector<ExtractJob> jobs;
+        uint32_t first_user = super_block.first_inode != 0 ? super_block.first_inode : 11; // 11 before revision 1
+        auto consider = [&](uint32_t inode_num, const ext2_inode& inode) {
+            // reserved inodes (the resize inode is a regular file) hold no user data
+            if (inode_num < first_user) return;
+            if ((inode.mode & 0xF000) != EXT2_I_FTYPE) return;
+            bool deleted = inode.deletion_time != 0 || inode.link_count == 0;
+            if (!all && !deleted) return;
+            ExtractJob job = extractionJob(inode_num, inode);
+            if (!job.extents.empty()) jobs.push_back(std::move(job));
+        };
+        if (image_resident) {
+            // --sequential already decoded every inode table
+            for (size_t i = 0; i < inode_catalog.size(); i++) consider(static_cast<uint32_t>(i + 1), inode_catalog[i]);
+        } else {
+            uint32_t per_block = geometry.inodesPerBlock();
+            uint32_t table_blocks = (super_block.inodes_per_group + per_block - 1) / per_block;
+            for (uint32_t g = 0; g < num_block_groups; g++) {
+                for (uint32_t tb = 0; tb < table_blocks; tb++) {
+                    auto table = fetchBlock(bgd_table[g].inode_table + tb);
+                    if (!table) continue;
+                    uint32_t first = tb * per_block;
+                    uint32_t count = std::min(per_block, super_block.inodes_per_group - first);
+                    for (uint32_t j = 0; j < count; j++) {
+                        ext2_inode inode;
+                        std::memcpy(&inode, table.value().data() + j * geometry.inode_size, sizeof(inode));
+                        consider(g * super_block.inodes_per_group + first + j + 1, inode);
+                    }
+                }
+            }
+        }
+        ContentExtractor extractor(image_path, dir, ledger ? block_size : 0);
+        size_t written = extractor.run(jobs);
+        if (ledger) ledger->merge(extractor.hashedBlocks());
+        return {jobs.size(), written};
+    }
+
+    // Coalesced extents of one file. Holes are kept; block numbers past the end
+    // of the volume (reused pointer blocks of a deleted file) are dropped. A
+    // deleted inode with its size cleared keeps every mapped block.
+    ExtractJob extractionJob(uint32_t inode_num, const ext2_inode& inode) {
+        ExtractJob job;
+        job.name = std::to_string(inode_num);
+        auto known = inode_to_info.find(inode_num);
+        if (known != inode_to_info.end() && !known->second.entries.empty()) {
+            job.name = extractFileName(job.name + "_", known->second.entries.front().name);
+        }
+        BlockSource source{*this};
+        BlockMapIterator<BlockSource> walk(inode, block_size, source, false);
+        BlockRef ref{};
+        uint64_t mapped_end = 0;
+        while (walk.next(ref)) {
+            if (ref.block >= super_block.block_count) continue;
+            uint64_t file_offset = static_cast<uint64_t>(ref.logical) * block_size;
+            uint64_t image_offset = geometry.blockOffset(ref.block);
+            FileExtent* last = job.extents.empty() ? nullptr : &job.extents.back();
+            if (last && last->file_offset + last->length == file_offset &&
+                last->image_offset + last->length == image_offset) {
+                last->length += block_size;
+            } else {
+                job.extents.push_back({file_offset, image_offset, block_size});
+            }
+            mapped_end = file_offset + block_size;
+        }
+        job.size = inode.size != 0 ? inode.size : mapped_end;
+        // the tail of the last block is not file content
+        while (!job.extents.empty() && job.extents.back().file_offset >= job.size) job.extents.pop_back();
+        if (!job.extents.empty()) {
+            FileExtent& tail = job.extents.back();
+            tail.length = std::min(tail.length, job.size - tail.file_offset);
+        }
+        return job;
+    }
+
+    // Counts, for every rm/rmdir, the data blocks its inode still maps and how
+    // many of those are neither allocated nor owned by a live inode.
+    void annotateIntact(vector<Action>& actions) {
+        for (Action& action : actions) {
+            if ((action.action != "rm" && action.action != "rmdir") || action.affected_inodes.empty()) continue;
+            auto inode = fetchInode(action.affected_inodes[0]);
+            if (!inode) continue;
+            if (!owners) buildBlockOwners();
+            BlockSource source{*this};
+            BlockMapIterator<BlockSource> walk(inode.value(), block_size, source, false);
+            BlockRef ref{};
+            action.intact_known = true;
+            while (walk.next(ref)) {
+                action.data_blocks++;
+                if (owners->intact(ref.block)) action.intact_blocks++;
+            }
+        }
+    }
+
+    // Reverse block map over every live inode in one pass over the inode tables,
+    // groups handed out to a thread pool. Each worker reads through its own
+    // buffered reader, so they share no state with the scanner's; under
+    // --manifest each hashes what it reads and the ledger merges the lists.
+    void buildBlockOwners() {
+        owners = std::make_unique<BlockOwners>(super_block.block_count, super_block.first_data_block,
+                                               super_block.blocks_per_group, num_block_groups);
+        std::atomic<uint32_t> next{0};
+        unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), num_block_groups));
+        vector<BlockHashLedger::Hashed> hashed(threads);
+        vector<ImageReader> readers(threads);
+        for (auto& reader : readers) {
+            if (!reader.open(image.filename(), false)) {
+                throw std::runtime_error("Failed to open filesystem image: " + image.filename());
+            }
+        }
+        vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back([&, t] { claimGroups(readers[t], next, ledger ? &hashed[t] : nullptr); });
+        }
+        for (auto& worker : pool) worker.join();
+        if (ledger) {
+            for (const auto& blocks : hashed) ledger->merge(blocks);
+        }
+    }
+
+    struct OwnerSource {
+        ImageReader& reader;
+        const Ext2Geometry& geometry;
+        uint32_t block_size;
+        uint32_t block_count;
+        BlockOwners& owners;
+        BlockHashLedger::Hashed* hashed;
+        uint32_t inode = 0;
+
+        bool read(uint32_t block, char* into) {
+            if (block >= block_count) return false;
+            if (reader.readAt(geometry.blockOffset(block), into, block_size) != block_size) return false;
+            if (hashed) hashed->push_back({block, xxh3::hash(into, block_size)});
+            return true;
+        }
+
+        // pointer blocks belong to the inode as much as its data does
+        bool readPointers(uint32_t block, std::vector<char>& into) {
+            into.resize(block_size);
+            if (!read(block, into.data())) return false;
+            owners.claim(block, inode);
+            return true;
+        }
+
+        void prefetch(const uint32_t*, uint32_t) {}
+    };
+
+    // Table blocks are read one at a time so each is hashed like a fetchBlock();
+    // a table block that cannot be read ends the group's table.
+    void claimGroups(ImageReader& reader, std::atomic<uint32_t>& next, BlockHashLedger::Hashed* hashed) {
+        OwnerSource source{reader, geometry, block_size, super_block.block_count, *owners, hashed};
+        uint32_t per_block = geometry.inodesPerBlock();
+        uint32_t table_blocks = (super_block.inodes_per_group + per_block - 1) / per_block;
+        vector<char> table(static_cast<size_t>(table_blocks) * block_size), bitmap(block_size);
+        for (uint32_t g = next++; g < num_block_groups; g = next++) {
+            if (source.read(bgd_table[g].block_bitmap, bitmap.data())) {
+                owners->setBitmap(g, bitmap.data());
+            }
+            uint32_t read_blocks = 0;
+            for (; read_blocks < table_blocks; read_blocks++) {
+                char* into = table.data() + static_cast<size_t>(read_blocks) * block_size;
+                if (!source.read(bgd_table[g].inode_table + read_blocks, into)) break;
+            }
+            uint32_t count = std::min(super_block.inodes_per_group, read_blocks * per_block);
+            for (uint32_t j = 0; j < count; j++) {
+                ext2_inode inode;
+                std::memcpy(&inode, table.data() + static_cast<size_t>(j) * geometry.inode_size, sizeof(inode));
+                if (inode.mode == 0 || inode.link_count == 0 || inode.deletion_time != 0) continue;
+                // only these keep block numbers in i_block; a fast symlink keeps its target there
+                uint16_t type = inode.mode & 0xF000;
+                bool mapped = type == EXT2_I_FTYPE || type == EXT2_I_DTYPE || (type == 0xA000 && inode.size >= 60);
+                if (!mapped) continue;
+                source.inode = g * super_block.inodes_per_group + j + 1;
+                BlockMapIterator<OwnerSource> walk(inode, block_size, source, false);
+                BlockRef ref{};
+                while (walk.next(ref)) owners->claim(ref.block, source.inode);
+            }
+        }
+    }
+
+    // Columnar dump of the catalog: inodes.arrow (decoded ext2_inode fields),
+    // dirents.arrow (live and ghost entries) and paths.arrow (path_id -> path).
+    void exportArrow(const string& dir) const {
+        std::filesystem::create_directories(dir);
+        size_t n = inode_to_info.size();
+        vector<uint32_t> inode(n), size(n), atime(n), ctime(n), mtime(n), dtime(n), blocks512(n), flags(n);
+        vector<uint32_t> single(n), dbl(n), triple(n);
+        vector<vector<uint32_t>> direct(EXT2_NUM_DIRECT_BLOCKS, vector<uint32_t>(n));
+        vector<uint16_t> mode(n), uid(n), gid(n), links(n);
+
+        vector<uint32_t> d_inode, d_parent, d_path;
+        vector<bool> d_ghost;
+        vector<string> d_name;
+        std::unordered_map<string, uint32_t> path_ids;
+        vector<string> paths;
+
+        size_t row = 0;
+        for (const auto& [num, record] : inode_to_info) {
+            const ext2_inode& in = record.inode_data;
+            inode[row] = num;
+            mode[row] = in.mode;
+            uid[row] = in.uid;
+            gid[row] = in.gid;
+            size[row] = in.size;
+            atime[row] = in.access_time;
+            ctime[row] = in.change_time;
+            mtime[row] = in.modification_time;
+            dtime[row] = in.deletion_time;
+            links[row] = in.link_count;
+            blocks512[row] = in.block_count_512;
+            flags[row] = in.flags;
+            for (int i = 0; i < EXT2_NUM_DIRECT_BLOCKS; i++) direct[i][row] = in.direct_blocks[i];
+            single[row] = in.single_indirect;
+            dbl[row] = in.double_indirect;
+            triple[row] = in.triple_indirect;
+            row++;
+
+            for (const auto& e : record.entries) {
+                auto [it, inserted] = path_ids.try_emplace(e.full_path, static_cast<uint32_t>(paths.size()));
+                if (inserted) paths.push_back(e.full_path);
+                d_inode.push_back(num);
+                d_parent.push_back(e.parent_inode);
+                d_ghost.push_back(e.is_ghost);
+                d_name.push_back(e.name);
+                d_path.push_back(it->second);
+            }
+        }
+
+        ArrowTableWriter inodes(n);
+        inodes.addUInt32("inode", inode);
+        inodes.addUInt16("mode", mode);
+        inodes.addUInt16("uid", uid);
+        inodes.addUInt16("gid", gid);
+        inodes.addUInt32("size", size);
+        inodes.addUInt32("access_time", atime);
+        inodes.addUInt32("change_time", ctime);
+        inodes.addUInt32("modification_time", mtime);
+        inodes.addUInt32("deletion_time", dtime);
+        inodes.addUInt16("link_count", links);
+        inodes.addUInt32("block_count_512", blocks512);
+        inodes.addUInt32("flags", flags);
+        for (int i = 0; i < EXT2_NUM_DIRECT_BLOCKS; i++) {
+            inodes.addUInt32("direct_block_" + std::to_string(i), direct[i]);
+        }
+        inodes.addUInt32("single_indirect", single);
+        inodes.addUInt32("double_indirect", dbl);
+        inodes.addUInt32("triple_indirect", triple);
+        inodes.write(dir + "/inodes.arrow");
+
+        ArrowTableWriter dirents(d_inode.size());
+        dirents.addUInt32("inode", d_inode);
+        dirents.addUInt32("parent_inode", d_parent);
+        dirents.addBool("is_ghost", d_ghost);
+        dirents.addBinary("name", d_name);
+        dirents.addUInt32("path_id", d_path);
+        dirents.write(dir + "/dirents.arrow");
+
+        vector<uint32_t> ids(paths.size());
+        for (size_t i = 0; i < ids.size(); i++) ids[i] = static_cast<uint32_t>(i);
+        ArrowTableWriter path_table(paths.size());
+        path_table.addUInt32("path_id", ids);
+        path_table.addBinary("path", paths);
+        path_table.write(dir + "/paths.arrow");
+    }
+
+    // Every live and ghost dirent the traversal recorded, keyed for lookups.
+    DirentIndex buildIndex() const {
+        DirentIndex index;
+        for (const auto& [inode, record] : inode_to_info) {
+            for (const auto& e : record.entries) {
+                index.add({inode, e.parent_inode, e.is_ghost, e.name, e.full_path});
+            }
+        }
+        return index;
+    }
+
+    // Alternative engine: read the image front to back once and serve every later
+    // inode and directory block lookup from memory.
+    void loadSequential() {
+        streamImage();
+    }
+
 
 private:
     void readSuperBlock() {
-        fs_file.seekg(EXT2_SUPER_BLOCK_POSITION);
-        if (!fs_file.read(reinterpret_cast<char*>(&super_block), sizeof(ext2_super_block))) {
+        if (image.readAt(EXT2_SUPER_BLOCK_POSITION, &super_block, sizeof(ext2_super_block)) !=
+            sizeof(ext2_super_block)) {
             throw std::runtime_error("Failed to read superblock");
         }
         
@@ -98,65 +642,269 @@ private:
         block_size = EXT2_UNLOG(super_block.log_block_size);
         num_block_groups = (super_block.block_count + super_block.blocks_per_group - 1) / 
                           super_block.blocks_per_group;
+
+        // revision 0 images leave inode_size unset and always use 128-byte inodes
+        uint32_t inode_size = super_block.rev_level == 0 ? 128 : super_block.inode_size;
+        if (!makeGeometry(block_size, inode_size, super_block.inodes_per_group, geometry)) {
+            throw std::runtime_error("Unsupported geometry: block size " + std::to_string(block_size) +
+                                   ", inode size " + std::to_string(inode_size));
+        }
     }
     
     void readBGDTable() {
         uint32_t bgd_table_block = super_block.first_data_block + 1;
         bgd_table.resize(num_block_groups);
         
-        fs_file.seekg(bgd_table_block * block_size);
-        if (!fs_file.read(reinterpret_cast<char*>(bgd_table.data()), 
-                         num_block_groups * sizeof(ext2_block_group_descriptor))) {
+        size_t table_bytes = num_block_groups * sizeof(ext2_block_group_descriptor);
+        if (image.readAt(geometry.blockOffset(bgd_table_block), bgd_table.data(), table_bytes) != table_bytes) {
             throw std::runtime_error("Failed to read block group descriptor table");
         }
     }
     
-    std::vector<char> readBlock(uint32_t block_num) {
+    // Hot path: every pointer is range checked before any I/O and failures come
+    // back as a status, counted in the scan stats.
+    ReadResult<std::vector<char>> fetchBlock(uint32_t block_num, bool rehash = true) {
+        if (block_num >= super_block.block_count) {
+            ScanProgress::bump(progress.blocks_rejected);
+            return ReadStatus::BlockOutOfRange;
+        }
+        if (image_resident) {
+            auto it = resident_blocks.find(block_num);
+            if (it != resident_blocks.end()) {
+                return it->second;
+            }
+        }
         std::vector<char> buffer(block_size);
-        fs_file.seekg(block_num * block_size);
-        if (!fs_file.read(buffer.data(), block_size)) {
-            throw std::runtime_error("Failed to read block " + std::to_string(block_num));
+        if (image.readAt(geometry.blockOffset(block_num), buffer.data(), block_size) != block_size) {
+            ScanProgress::bump(progress.short_reads);
+            return ReadStatus::ShortRead;
         }
+        ScanProgress::bump(progress.blocks_scanned);
+        if (ledger && (rehash || !ledger->recorded(block_num))) ledger->record(block_num, buffer.data(), block_size);
         return buffer;
     }
-    
-    ext2_inode readInode(uint32_t inode_num) {
+
+    // Inode 0 reads as all zeroes, which the inference code relies on for
+    // unknown parents.
+    ReadResult<ext2_inode> fetchInode(uint32_t inode_num) {
         ext2_inode inode;
         std::memset(&inode, 0, sizeof(inode));
         
         if (inode_num == 0) {
             return inode;
         }
+        if (inode_num > super_block.inode_count) {
+            ScanProgress::bump(progress.inodes_rejected);
+            return ReadStatus::InodeOutOfRange;
+        }
+
+        if (image_resident) {
+            if (inode_num > inode_catalog.size()) {
+                ScanProgress::bump(progress.inodes_rejected);
+                return ReadStatus::InodeOutOfRange;
+            }
+            return inode_catalog[inode_num - 1];
+        }
         
-        // which block group contains this inode
-        uint32_t group = (inode_num - 1) / super_block.inodes_per_group;
-        uint32_t index = (inode_num - 1) % super_block.inodes_per_group;
+        // which block group contains this inode, and where in its table
+        InodeSlot slot = geometry.locate(geometry, inode_num);
         
-        if (group >= num_block_groups) {
-            throw std::runtime_error("Invalid inode group: " + std::to_string(group));
+        if (slot.group >= num_block_groups) {
+            ScanProgress::bump(progress.inodes_rejected);
+            return ReadStatus::InodeOutOfRange;
         }
 
-        uint32_t inode_table_block = bgd_table[group].inode_table;
-        uint32_t inodes_per_block = block_size / super_block.inode_size;
-        uint32_t block_offset = index / inodes_per_block;
-        uint32_t inode_offset = (index % inodes_per_block) * super_block.inode_size;
-        
-        // read the inode's block
-        auto block_buffer = readBlock(inode_table_block + block_offset);
-        std::memcpy(&inode, block_buffer.data() + inode_offset, sizeof(ext2_inode));
+        // read the inode's block; the walk re-reads a table block for every
+        // inode in it, so the manifest hashes it only the first time
+        auto block_buffer = fetchBlock(bgd_table[slot.group].inode_table + slot.block, false);
+        if (!block_buffer) return block_buffer.status();
+        std::memcpy(&inode, block_buffer.value().data() + slot.offset, sizeof(ext2_inode));
         
         return inode;
     }
+
+    // Throwing forms for setup and action inference, where a failure is fatal
+    // or already handled by the caller.
+    std::vector<char> readBlock(uint32_t block_num) {
+        auto block = fetchBlock(block_num);
+        if (!block) {
+            throw std::runtime_error("Failed to read block " + std::to_string(block_num) + ": " +
+                                     readStatusName(block.status()));
+        }
+        return block.take();
+    }
+
+    ext2_inode readInode(uint32_t inode_num) {
+        auto inode = fetchInode(inode_num);
+        if (!inode) {
+            throw std::runtime_error("Invalid inode " + std::to_string(inode_num) + ": " +
+                                     readStatusName(inode.status()));
+        }
+        return inode.value();
+    }
     
+    // A block whose records chain exactly to the block end; cheap enough to run
+    // on every streamed block that might turn out to belong to a directory.
+    bool looksLikeDirectoryBlock(const char* data) const {
+        uint32_t offset = 0;
+        while (offset < block_size) {
+            const ext2_dir_entry* entry = reinterpret_cast<const ext2_dir_entry*>(data + offset);
+            if (entry->length < 8 || (entry->length & 3) || offset + entry->length > block_size ||
+                entry->name_length + 8u > entry->length) {
+                return false;
+            }
+            offset += entry->length;
+        }
+        return offset == block_size;
+    }
+
+    // Pointer blocks are in-range block numbers followed by zero padding.
+    bool looksLikePointerBlock(const char* data) const {
+        const uint32_t* ptrs = reinterpret_cast<const uint32_t*>(data);
+        uint32_t count = block_size / sizeof(uint32_t);
+        if (ptrs[0] == 0) return false;
+        bool seen_zero = false;
+        for (uint32_t i = 0; i < count; i++) {
+            if (ptrs[i] == 0) { seen_zero = true; continue; }
+            if (seen_zero || ptrs[i] >= super_block.block_count) return false;
+        }
+        return true;
+    }
+
+    // Registers the blocks a directory inode needs. level is how many pointer
+    // hops remain below the block: 0 for data blocks.
+    void wantDirectoryBlock(uint32_t block_num, int level, uint32_t stream_pos,
+                            unordered_map<uint32_t, int>& wanted,
+                            unordered_map<uint32_t, vector<char>>& deferred) {
+        if (block_num == 0 || block_num >= super_block.block_count || resident_blocks.count(block_num)) {
+            return;
+        }
+        if (block_num < stream_pos) {
+            // already streamed past; only recoverable if it was kept as a candidate
+            auto it = deferred.find(block_num);
+            if (it == deferred.end()) {
+                wanted[block_num] = level;
+                return;
+            }
+            auto& data = resident_blocks[block_num];
+            data = std::move(it->second);
+            deferred.erase(it);
+            if (level > 0) expandPointerBlock(data.data(), level, stream_pos, wanted, deferred);
+            return;
+        }
+        wanted[block_num] = level;
+    }
+
+    void expandPointerBlock(const char* data, int level, uint32_t stream_pos,
+                            unordered_map<uint32_t, int>& wanted,
+                            unordered_map<uint32_t, vector<char>>& deferred) {
+        const uint32_t* ptrs = reinterpret_cast<const uint32_t*>(data);
+        uint32_t count = block_size / sizeof(uint32_t);
+        for (uint32_t i = 0; i < count && ptrs[i] != 0; i++) {
+            wantDirectoryBlock(ptrs[i], level - 1, stream_pos, wanted, deferred);
+        }
+    }
+
+    void streamImage() {
+        const uint32_t inode_size = geometry.inode_size;
+        const uint32_t table_blocks = (super_block.inodes_per_group * inode_size + block_size - 1) / block_size;
+        inode_catalog.assign(static_cast<size_t>(num_block_groups) * super_block.inodes_per_group, ext2_inode{});
+        inode_columns.resize(inode_catalog.size());
+
+        // inode table ranges in image order
+        vector<std::pair<uint32_t, uint32_t>> tables; // first block, group
+        for (uint32_t g = 0; g < num_block_groups; g++) {
+            tables.push_back({bgd_table[g].inode_table, g});
+        }
+        std::sort(tables.begin(), tables.end());
+        size_t table_idx = 0;
+
+        unordered_map<uint32_t, int> wanted;
+        unordered_map<uint32_t, vector<char>> deferred;
+
+        const uint32_t chunk_blocks = std::max<uint32_t>(1, (1u << 20) / block_size);
+        AlignedBuffer chunk(static_cast<size_t>(chunk_blocks) * block_size);
+        image.adviseSequential();
+
+        for (uint32_t base = 0; base < super_block.block_count; base += chunk_blocks) {
+            uint32_t count = std::min(chunk_blocks, super_block.block_count - base);
+            uint64_t offset = geometry.blockOffset(base);
+            size_t got = image.readAt(offset, chunk.data(), static_cast<size_t>(count) * block_size);
+            image.dropCached(offset, got);
+            count = static_cast<uint32_t>(got / block_size);
+            if (count == 0) break;
+            ScanProgress::bump(progress.blocks_scanned, count);
+
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t block_num = base + i;
+                const char* data = chunk.data() + static_cast<size_t>(i) * block_size;
+
+                while (table_idx < tables.size() && tables[table_idx].first + table_blocks <= block_num) {
+                    table_idx++;
+                }
+                if (table_idx < tables.size() && block_num >= tables[table_idx].first) {
+                    uint32_t group = tables[table_idx].second;
+                    uint32_t first = (block_num - tables[table_idx].first) * geometry.inodesPerBlock();
+                    if (first >= super_block.inodes_per_group) continue;
+                    uint32_t in_block = std::min(geometry.inodesPerBlock(), super_block.inodes_per_group - first);
+                    size_t row = static_cast<size_t>(group) * super_block.inodes_per_group + first;
+                    if (ledger) ledger->record(block_num, data, block_size);
+                    inode_columns.decode(data, in_block, inode_size, row);
+                    ScanProgress::bump(progress.inodes_catalogued, in_block);
+                    for (uint32_t j = 0; j < in_block; j++) {
+                        std::memcpy(&inode_catalog[row + j], data + j * inode_size, sizeof(ext2_inode));
+                    }
+                    // directories are found from the mode column, their blocks from the pointer rows
+                    for (uint32_t j = 0; j < in_block; j++) {
+                        if (!(inode_columns.mode[row + j] & EXT2_I_DTYPE)) continue;
+                        const uint32_t* ptrs = inode_columns.blocks(row + j);
+                        for (int k = 0; k < EXT2_NUM_DIRECT_BLOCKS; k++) {
+                            wantDirectoryBlock(ptrs[k], 0, block_num + 1, wanted, deferred);
+                        }
+                        for (int level = 1; level <= 3; level++) {
+                            wantDirectoryBlock(ptrs[EXT2_NUM_DIRECT_BLOCKS + level - 1], level, block_num + 1,
+                                               wanted, deferred);
+                        }
+                    }
+                    continue;
+                }
+
+                auto it = wanted.find(block_num);
+                if (it != wanted.end()) {
+                    int level = it->second;
+                    wanted.erase(it);
+                    auto& stored = resident_blocks[block_num];
+                    stored.assign(data, data + block_size);
+                    if (level > 0) expandPointerBlock(stored.data(), level, block_num + 1, wanted, deferred);
+                } else if (looksLikeDirectoryBlock(data) || looksLikePointerBlock(data)) {
+                    deferred[block_num].assign(data, data + block_size);
+                }
+            }
+            uint32_t streamed = base + count;
+            progress.groups_processed.store(streamed >= super_block.block_count ? num_block_groups
+                                                : streamed / super_block.blocks_per_group,
+                                            std::memory_order_relaxed);
+        }
+        image.adviseRandom();
+        image_resident = true;
+        // The manifest lists what the analysis read: the inode tables above and
+        // the directory and pointer blocks kept for the walk. Data blocks that
+        // only streamed past are not hashed; a miss later is read and hashed
+        // through fetchBlock like in the graph walk.
+        if (ledger) {
+            for (const auto& [block_num, data] : resident_blocks) ledger->record(block_num, data.data(), block_size);
+        }
+        if (windowed) pruneOutsideWindow();
+    }
+
     uint32_t calculateEntrySize(uint8_t name_length) {   
         uint32_t size = 8 + name_length;
         uint32_t result = (size + 3) & ~3;
         return result; 
     }
     
-    vector<GhostEntry> findGhostEntries(const std::vector<char>& block_buffer, 
-                                           uint32_t start_offset, uint32_t available_space) {
-        vector<GhostEntry> ghosts;
+    void findGhostEntries(const std::vector<char>& block_buffer, uint32_t start_offset,
+                          uint32_t available_space, std::pmr::vector<GhostEntry>& ghosts) {
         uint32_t offset = start_offset;
         
         while (offset + sizeof(ext2_dir_entry) <= start_offset + available_space) {
@@ -165,7 +913,6 @@ private:
             
             if (potential_entry->inode == 0 || 
                 potential_entry->name_length == 0 || 
-                potential_entry->name_length > 255 ||
                 potential_entry->length == 0 ||
                 offset + potential_entry->name_length + 8 > start_offset + available_space) {
                
@@ -174,7 +921,7 @@ private:
             }                    
             GhostEntry ghost;
             ghost.inode = potential_entry->inode;
-            ghost.name = std::string(potential_entry->name, potential_entry->name_length);
+            ghost.name = std::string_view(potential_entry->name, potential_entry->name_length);
             ghost.file_type = potential_entry->file_type;
                 
             if (ghost.name != "." && ghost.name != "..") {
@@ -185,13 +932,171 @@ private:
             uint32_t entry_size = calculateEntrySize(potential_entry->name_length);
             offset += entry_size;    
         }
-        return ghosts;
+    }
+
+    // Same range check as fetchInode, without the read.
+    bool inodeInRange(uint32_t inode_num) const {
+        return inode_num <= super_block.inode_count &&
+               (inode_num == 0 || (inode_num - 1) / super_block.inodes_per_group < num_block_groups);
+    }
+
+    // For dirents skipped without a read: out-of-range numbers are counted as
+    // rejected, as fetchInode would have counted them.
+    bool acceptDirentInode(uint32_t inode_num) {
+        if (inodeInRange(inode_num)) return true;
+        ScanProgress::bump(progress.inodes_rejected);
+        return false;
+    }
+
+    // With the inode tables in memory the window test runs once over the timestamp
+    // columns instead of per recorded inode.
+    void pruneOutsideWindow() {
+        std::vector<uint8_t> outside;
+        inode_columns.outsideWindow(window_since, window_until, outside);
+        for (size_t r = 0; r < outside.size(); r++) {
+            if (outside[r]) pruned_inodes.set(static_cast<uint32_t>(r + 1));
+        }
+    }
+
+    // Every action of an inode lies between its creation (no later than any of
+    // its own timestamps) and its latest timestamp.
+    bool mayHaveEventsInWindow(const ext2_inode& inode) const {
+        uint32_t latest = std::max({inode.access_time, inode.change_time,
+                                    inode.modification_time, inode.deletion_time});
+        uint32_t earliest = std::min({inode.access_time, inode.change_time, inode.modification_time});
+        return latest >= window_since && earliest <= window_until;
+    }
+
+    // False when the inode number is unusable; pruned inodes count as handled.
+    bool recordEntry(uint32_t inode_num, std::string_view name, const std::string& current_path,
+                     uint32_t dir_inode, bool is_ghost) {
+        auto it = inode_to_info.find(inode_num);
+        if (it == inode_to_info.end()) {
+            if (pruned_inodes.test(inode_num)) return true;
+            // read first: a bad inode number must not leave an empty record behind
+            auto inode_data = fetchInode(inode_num);
+            if (!inode_data) return false;
+            if (windowed && !mayHaveEventsInWindow(inode_data.value())) {
+                pruned_inodes.set(inode_num);
+                return true;
+            }
+            it = inode_to_info.try_emplace(inode_num).first;
+            it->second.inode_data = inode_data.value();
+            if (!image_resident) ScanProgress::bump(progress.inodes_catalogued);
+        }
+        string full_path = "/";
+        if (!current_path.empty()) {
+            full_path += current_path;
+            full_path += '/';
+        }
+        full_path += name;
+        it->second.entries.push_back({full_path, string(name), dir_inode, is_ghost});
+        return true;
+    }
+
+    // Reads every directory inode's listing once and records only dirents that
+    // name one of the wanted inodes. Paths are rebuilt upward through "..".
+    void sweepDirectoriesFor(const std::set<uint32_t>& wanted) {
+        std::unordered_map<uint32_t, string> path_cache;
+        uint32_t per_block = geometry.inodesPerBlock();
+        uint32_t table_blocks = (super_block.inodes_per_group + per_block - 1) / per_block;
+
+        for (uint32_t g = 0; g < num_block_groups; g++) {
+            for (uint32_t tb = 0; tb < table_blocks; tb++) {
+                auto table_block = fetchBlock(bgd_table[g].inode_table + tb);
+                if (!table_block) continue;
+                const std::vector<char>& table = table_block.value();
+                for (uint32_t j = 0; j < per_block; j++) {
+                    uint32_t index = tb * per_block + j;
+                    if (index >= super_block.inodes_per_group) break;
+                    uint32_t dir_num = g * super_block.inodes_per_group + index + 1;
+                    ext2_inode dir;
+                    std::memcpy(&dir, table.data() + j * geometry.inode_size, sizeof(ext2_inode));
+                    if (!(dir.mode & EXT2_I_DTYPE)) continue;
+
+                    const DirectoryListing& listing = directoryListing(dir_num, dir);
+                    for (const auto& live : listing.live) {
+                        if (wanted.count(live.inode)) {
+                            recordSweptEntry(live.inode, live.name, dir_num, false, path_cache);
+                        }
+                    }
+                    for (const auto& ghost : listing.ghosts) {
+                        if (wanted.count(ghost.inode)) {
+                            recordSweptEntry(ghost.inode, ghost.name, dir_num, true, path_cache);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void recordSweptEntry(uint32_t inode_num, std::string_view name, uint32_t dir_num, bool is_ghost,
+                          std::unordered_map<uint32_t, string>& path_cache) {
+        string full_path = "/" + joinPath(directoryPath(dir_num, 0, path_cache), name);
+        inode_to_info[inode_num].entries.push_back({full_path, string(name), dir_num, is_ghost});
+    }
+
+    // Path of a directory relative to the root, found by following ".." and
+    // looking the directory up by inode in its parent (live entries first).
+    string directoryPath(uint32_t dir_num, int level, std::unordered_map<uint32_t, string>& path_cache) {
+        if (dir_num == EXT2_ROOT_INODE) return "";
+        auto cached = path_cache.find(dir_num);
+        if (cached != path_cache.end()) return cached->second;
+        if (level > 64) return "?";
+
+        string path = "?";
+        const DirectoryListing* dir = directoryListing(dir_num);
+        uint32_t parent = dir ? dir->parent_inode : 0;
+        const DirectoryListing* parent_dir = parent != 0 ? directoryListing(parent) : nullptr;
+        if (parent_dir) {
+            const DirectoryListing& parent_listing = *parent_dir;
+            string name;
+            for (const auto& live : parent_listing.live) {
+                if (live.inode == dir_num) { name = string(live.name); break; }
+            }
+            if (name.empty()) {
+                for (const auto& ghost : parent_listing.ghosts) {
+                    if (ghost.inode == dir_num) { name = string(ghost.name); break; }
+                }
+            }
+            if (!name.empty()) {
+                path = joinPath(directoryPath(parent, level + 1, path_cache), name);
+            }
+        }
+        path_cache[dir_num] = path;
+        return path;
+    }
+
+    // Looks name up in a directory, preferring a live entry over a ghost one.
+    uint32_t findChildDirectory(uint32_t dir_num, const string& name) {
+        const DirectoryListing& listing = directoryListing(dir_num, readInode(dir_num));
+        for (const auto& live : listing.live) {
+            if (live.name == name) return live.inode;
+        }
+        for (const auto& ghost : listing.ghosts) {
+            if (ghost.name == name) return ghost.inode;
+        }
+        throw std::runtime_error("No such directory entry: " + name);
+    }
+
+    static string joinPath(const std::string& current_path, std::string_view name) {
+        string path = current_path;
+        if (!path.empty()) path += '/';
+        path += name;
+        return path;
     }
     
     void traverseDirectory(uint32_t inode_num, int depth, const std::string& current_path, 
                           const std::string& dir_name = "", bool is_ghost = false) {
-        ext2_inode inode = readInode(inode_num); 
-        
+        // a stale ghost or a reused inode can point back at an ancestor
+        if (on_path.test(inode_num)) {
+            return;
+        }
+        auto fetched = fetchInode(inode_num);
+        if (!fetched) {
+            return;
+        }
+        const ext2_inode& inode = fetched.value();
         if (!(inode.mode & EXT2_I_DTYPE)) {
             return;
         }
@@ -199,7 +1104,7 @@ private:
         if (!dir_name.empty() || depth == 1) {
             std::string indent(depth, '-');
             if (depth == 1) {
-                cout << indent << " " << inode_num << ":root/\n";
+                cout << indent << " " << inode_num << ":" << dir_name << "/\n";
             } else {
                 if (is_ghost) {
                     cout << indent << " (" << inode_num << ":" << dir_name << "/)\n";
@@ -209,156 +1114,248 @@ private:
             }
         }
         
-        // Read directory data blocks
-        for (int i = 0; i < EXT2_NUM_DIRECT_BLOCKS && inode.direct_blocks[i] != 0; i++) {
-            try {
-                auto block_buffer = readBlock(inode.direct_blocks[i]);
-                processDirectoryBlockWithGhosts(block_buffer, depth + 1, current_path,inode_num, is_ghost);
-            } catch (const std::exception& e) {
-                //std::cerr << "Error reading directory block: " << e.what() << "\n";
+        // A directory last modified before the window had no dirent changes in
+        // it; one reached again (live and as a ghost, or through a reused inode)
+        // is rendered from its cached listing but its entries are recorded once.
+        bool record = (!windowed || inode.modification_time >= window_since) && !walked_dirs.test(inode_num);
+        walked_dirs.set(inode_num);
+        on_path.set(inode_num);
+        if (!is_ghost) ScanProgress::bump(progress.dirs_walked);
+        scanDirectory(directoryListing(inode_num, inode), depth + 1, current_path, inode_num, is_ghost, record);
+        on_path.reset(inode_num);
+    }
+
+    // Reads the directory's data blocks in logical order. A bad pointer block
+    // drops the rest of its subtree, a bad direct block only itself.
+    void collectDirectoryBlocks(const ext2_inode& inode, std::vector<std::vector<char>>& blocks) {
+        BlockSource source{*this, true};
+        BlockMapIterator<BlockSource> walk(inode, block_size, source);
+        BlockRef ref{};
+        while (walk.next(ref)) {
+            auto block = fetchDirectoryBlock(ref.block);
+            if (!block) {
+                if (ref.root != 0) walk.skipRoot();
                 continue;
             }
+            blocks.push_back(block.take());
         }
-        
-        if (inode.single_indirect != 0) {
-            try {
-                auto indirect_block = readBlock(inode.single_indirect);
-                uint32_t* block_pointers = reinterpret_cast<uint32_t*>(indirect_block.data());
-                uint32_t pointers_per_block = block_size / sizeof(uint32_t);
-                
-                for (uint32_t i = 0; i < pointers_per_block && block_pointers[i] != 0; i++) {
-                    auto block_buffer = readBlock(block_pointers[i]);
-                    processDirectoryBlockWithGhosts(block_buffer, depth + 1, current_path,inode_num, is_ghost);
-                }
-            } catch (const std::exception& e) {
-                //std::cerr << "Error reading indirect directory block: " << e.what() << "\n";
-            }
+    }
+
+    // Directory and directory pointer blocks are what the streaming pass keeps;
+    // one missing from that set is the miss the --sequential warning reports.
+    // Other reads (--intact, --extract) were never meant to be resident.
+    ReadResult<std::vector<char>> fetchDirectoryBlock(uint32_t block_num) {
+        if (image_resident && block_num < super_block.block_count && !resident_blocks.count(block_num)) {
+            ScanProgress::bump(progress.resident_misses);
         }
+        return fetchBlock(block_num);
+    }
 
-        if (inode.double_indirect != 0) {
-            try {
-                auto double_block = readBlock(inode.double_indirect);
-                uint32_t* single_indirect_ptrs = reinterpret_cast<uint32_t*>(double_block.data());
-                uint32_t pointers_per_block = block_size / sizeof(uint32_t);
+    // I/O for BlockMapIterator: pointer blocks go through fetchBlock like any
+    // other, prefetch hints straight to the reader
+    struct BlockSource {
+        Ext2FileSystem& fs;
+        bool directory = false;
 
-                for (uint32_t i = 0; i < pointers_per_block && single_indirect_ptrs[i] != 0; i++) {
-                    auto indirect_block = readBlock(single_indirect_ptrs[i]);
-                    uint32_t* data_block_ptrs = reinterpret_cast<uint32_t*>(indirect_block.data());
+        bool readPointers(uint32_t block, std::vector<char>& into) {
+            auto pointers = directory ? fs.fetchDirectoryBlock(block) : fs.fetchBlock(block);
+            if (!pointers) return false;
+            into = pointers.take();
+            return true;
+        }
 
-                    for (uint32_t j = 0; j < pointers_per_block && data_block_ptrs[j] != 0; j++) {
-                        auto block_buffer = readBlock(data_block_ptrs[j]);
-                        processDirectoryBlockWithGhosts(block_buffer, depth + 1, current_path,is_ghost);
-                    }
-                }
-            } catch (const std::exception& e) {
-                //std::cerr << "Error reading double indirect directory block: " << e.what() << "\n";
+        void prefetch(const uint32_t* blocks, uint32_t count) { fs.prefetchBlocks(blocks, count); }
+    };
+
+    // Hints runs of consecutive block numbers to the page cache.
+    void prefetchBlocks(const uint32_t* blocks, uint32_t count) {
+        if (image_resident) return;
+        for (uint32_t i = 0; i < count;) {
+            uint32_t start = blocks[i], run = 1;
+            while (i + run < count && blocks[i + run] == start + run) run++;
+            i += run;
+            if (start != 0 && start < super_block.block_count) {
+                image.prefetch(geometry.blockOffset(start), static_cast<uint64_t>(run) * block_size);
             }
         }
+    }
+
+    struct SlackRegion {
+        uint32_t block;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct GhostKey {
+        uint32_t inode;
+        std::string_view name;
+        bool operator==(const GhostKey& other) const {
+            return inode == other.inode && name == other.name;
+        }
+    };
 
-        if (inode.triple_indirect != 0) {
-            try {
-                auto triple_block = readBlock(inode.triple_indirect);
-                uint32_t* double_indirect_ptrs = reinterpret_cast<uint32_t*>(triple_block.data());
-                uint32_t pointers_per_block = block_size / sizeof(uint32_t);
+    struct GhostKeyHash {
+        size_t operator()(const GhostKey& key) const {
+            return std::hash<std::string_view>()(key.name) * 31 + key.inode;
+        }
+    };
 
-                for (uint32_t i = 0; i < pointers_per_block && double_indirect_ptrs[i] != 0; i++) {
-                    auto double_block = readBlock(double_indirect_ptrs[i]);
-                    uint32_t* single_indirect_ptrs = reinterpret_cast<uint32_t*>(double_block.data());
+    struct DirectoryListing {
+        std::pmr::vector<LiveEntry> live;
+        std::pmr::vector<GhostEntry> ghosts;
+        std::pmr::vector<size_t> live_end;   // per block: end index into live
+        std::pmr::vector<size_t> ghost_end;  // per block: end index into ghosts
+        uint32_t parent_inode = 0;           // target of "..", 0 if absent
 
-                    for (uint32_t j = 0; j < pointers_per_block && single_indirect_ptrs[j] != 0; j++) {
-                        auto indirect_block = readBlock(single_indirect_ptrs[j]);
-                        uint32_t* data_block_ptrs = reinterpret_cast<uint32_t*>(indirect_block.data());
+        explicit DirectoryListing(std::pmr::memory_resource* arena)
+            : live(arena), ghosts(arena), live_end(arena), ghost_end(arena) {}
+    };
 
-                        for (uint32_t k = 0; k < pointers_per_block && data_block_ptrs[k] != 0; k++) {
-                            auto block_buffer = readBlock(data_block_ptrs[k]);
-                            processDirectoryBlockWithGhosts(block_buffer, depth + 1, current_path,is_ghost);
-                        }
+    // Every directory is read and parsed once per run. Only the compact
+    // listing is kept: names are copied into listing_arena and the block
+    // buffers are dropped. The tree walk, the live and ghost renderings of a
+    // reused inode, path rebuilding and the --inode sweep all share it.
+    std::pmr::monotonic_buffer_resource listing_arena{1 << 16};
+    std::unordered_map<uint32_t, std::unique_ptr<DirectoryListing>> listings;
+    ScanArena parse_scratch;
+    InodeBitset on_path;
+    // directories whose entries the walk has already recorded
+    InodeBitset walked_dirs;
+
+    const DirectoryListing& directoryListing(uint32_t dir_num, const ext2_inode& inode) {
+        auto it = listings.find(dir_num);
+        if (it != listings.end()) return *it->second;
+        std::vector<std::vector<char>> blocks;
+        collectDirectoryBlocks(inode, blocks);
+        auto listing = std::make_unique<DirectoryListing>(&listing_arena);
+        parseDirectory(blocks, *listing);
+        for (auto& live : listing->live) live.name = internName(live.name);
+        for (auto& ghost : listing->ghosts) ghost.name = internName(ghost.name);
+        return *listings.emplace(dir_num, std::move(listing)).first->second;
+    }
+
+    // nullptr when the inode number itself is unusable
+    const DirectoryListing* directoryListing(uint32_t dir_num) {
+        auto it = listings.find(dir_num);
+        if (it != listings.end()) return it->second.get();
+        auto inode = fetchInode(dir_num);
+        if (!inode) return nullptr;
+        return &directoryListing(dir_num, inode.value());
+    }
+
+    std::string_view internName(std::string_view name) {
+        char* copy = static_cast<char*>(listing_arena.allocate(name.size() + 1, 1));
+        std::memcpy(copy, name.data(), name.size());
+        return std::string_view(copy, name.size());
+    }
+
+    // Two phases over the whole directory: collect every live entry first, then
+    // carve the slack of every block and keep ghosts that are neither live
+    // anywhere in the directory nor already seen in another slack region.
+    void parseDirectory(const std::vector<std::vector<char>>& blocks, DirectoryListing& listing) {
+        parse_scratch.release();
+        std::pmr::memory_resource* arena = parse_scratch.get();
+        std::pmr::vector<SlackRegion> slack(arena);
+
+        for (uint32_t b = 0; b < blocks.size(); b++) {
+            const std::vector<char>& block_buffer = blocks[b];
+            uint32_t offset = 0;
+            while (offset < block_size) {
+                const ext2_dir_entry* entry = 
+                    reinterpret_cast<const ext2_dir_entry*>(block_buffer.data() + offset);
+                if (entry->length == 0) break;
+                if (entry->inode != 0) {
+                    std::string_view name(entry->name, entry->name_length);
+                    if (name != "." && name != "..") {
+                        live_inodes.set(entry->inode);
+                        listing.live.push_back({entry->inode, name, entry->file_type == EXT2_D_DTYPE});
+                    } else if (name == ".." && listing.parent_inode == 0) {
+                        listing.parent_inode = entry->inode;
                     }
                 }
-            } catch (const std::exception& e) {
-                //std::cerr << "Error reading triple indirect directory block: " << e.what() << "\n";
+
+                uint32_t actual_size = calculateEntrySize(entry->name_length);
+                if (entry->length > actual_size) {
+                    slack.push_back({b, offset + actual_size, entry->length - actual_size});
+                }
+                offset += entry->length;
             }
+            listing.live_end.push_back(listing.live.size());
         }
 
-    }
-    
-    void processDirectoryBlockWithGhosts(const std::vector<char>& block_buffer, int depth, 
-                                        const std::string& current_path,uint32_t dir_inode, bool parent_is_ghost = false) {
-        uint32_t offset = 0;
-        std::set<uint32_t> active_inodes;
-        vector<std::pair<std::string, uint32_t>> active_entries;
-        vector<GhostEntry> all_ghosts;
-                                          
-        while (offset < block_size) {
-            const ext2_dir_entry* entry = 
-                reinterpret_cast<const ext2_dir_entry*>(block_buffer.data() + offset);
-            if (entry->length == 0) break;
-            if (entry->inode != 0) {
-                string name(entry->name, entry->name_length);
-                if (name != "." && name != "..") {
-                    active_inodes.insert(entry->inode);
-                    ext2_inode inode_data = readInode(entry->inode);
-                    string full_path = current_path.empty() ? name : current_path + "/" + name;
-
-                    if (inode_to_info.find(entry->inode) == inode_to_info.end()) {
-                        inode_to_info[entry->inode].inode_data = inode_data;
-                    }
-                    inode_to_info[entry->inode].entries.push_back({"/"+full_path, name, dir_inode, false});
-
-                    if (entry->file_type == EXT2_D_DTYPE) {
-                        active_entries.push_back({name + "/", entry->inode});
-                    } else {
-                        active_entries.push_back({name, entry->inode});
+        std::pmr::vector<GhostEntry> carved(arena);
+        std::pmr::unordered_set<GhostKey, GhostKeyHash> seen_ghosts(arena);
+        size_t slack_idx = 0;
+        for (uint32_t b = 0; b < blocks.size(); b++) {
+            for (; slack_idx < slack.size() && slack[slack_idx].block == b; slack_idx++) {
+                carved.clear();
+                findGhostEntries(blocks[b], slack[slack_idx].offset, slack[slack_idx].length, carved);
+                for (const auto& ghost : carved) {
+                    if (live_inodes.test(ghost.inode) || !seen_ghosts.insert({ghost.inode, ghost.name}).second) {
+                        continue;
                     }
+                    listing.ghosts.push_back(ghost);
                 }
             }
+            listing.ghost_end.push_back(listing.ghosts.size());
+        }
+        // the next directory reuses the bitset
+        live_inodes.clear();
+    }
 
-            uint32_t actual_size = calculateEntrySize(entry->name_length);
-            if (entry->length > actual_size) {
-                uint32_t unused_space = entry->length - actual_size;
-                auto ghosts = findGhostEntries(block_buffer, offset + actual_size, unused_space);
-                for (const auto& ghost : ghosts) {
-                    if (active_inodes.find(ghost.inode) == active_inodes.end()) {
-                        all_ghosts.push_back(ghost);
-                        ext2_inode inode_data = readInode(ghost.inode);
-                        string full_path = current_path.empty() ? ghost.name : current_path + "/" + ghost.name;
+    void scanDirectory(const DirectoryListing& listing, int depth,
+                       const std::string& current_path, uint32_t dir_inode, bool parent_is_ghost = false,
+                       bool record = true) {
+        std::pmr::memory_resource* arena = block_arenas.enter(depth);
 
-                        if (inode_to_info.find(ghost.inode) == inode_to_info.end()) {
-                            inode_to_info[ghost.inode].inode_data = inode_data;
-                        }
-                        inode_to_info[ghost.inode].entries.push_back({"/"+full_path, ghost.name, dir_inode, true});
-                    }
-                }
+        // an unreadable inode number drops only its own record
+        std::pmr::vector<char> live_ok(listing.live.size(), 0, arena);
+        std::pmr::vector<char> ghost_ok(listing.ghosts.size(), 0, arena);
+        for (size_t i = 0; i < listing.live.size(); i++) {
+            if (!record) {
+                live_ok[i] = acceptDirentInode(listing.live[i].inode);
+                continue;
             }
-            offset += entry->length;
+            live_ok[i] = recordEntry(listing.live[i].inode, listing.live[i].name, current_path, dir_inode, false);
+        }
+        for (size_t i = 0; i < listing.ghosts.size(); i++) {
+            if (!record) {
+                ghost_ok[i] = acceptDirentInode(listing.ghosts[i].inode);
+                continue;
+            }
+            ghost_ok[i] = recordEntry(listing.ghosts[i].inode, listing.ghosts[i].name, current_path, dir_inode, true);
+            if (ghost_ok[i]) ScanProgress::bump(progress.ghosts_found);
         }
 
-        for (const auto& [name, inode] : active_entries) {
-            string indent(depth, '-');
-            if (name.back() == '/') {
-                string dir_name = name.substr(0, name.length() - 1);
-                string new_path = current_path.empty() ? dir_name : current_path + "/" + dir_name;
-                traverseDirectory(inode, depth, new_path, dir_name, parent_is_ghost);
-            } else {
-                if (parent_is_ghost) {
-                    //std::cout << indent << " (" << inode << ":" << name << ")\n";
+        size_t live_idx = 0, ghost_idx = 0;
+        std::string indent(depth, '-');
+        for (uint32_t b = 0; b < listing.live_end.size(); b++) {
+            for (; live_idx < listing.live_end[b]; live_idx++) {
+                if (!live_ok[live_idx]) continue;
+                const LiveEntry& live = listing.live[live_idx];
+                if (live.is_dir) {
+                    traverseDirectory(live.inode, depth, joinPath(current_path, live.name), string(live.name), parent_is_ghost);
                 } else {
-                    std::cout << indent << " " << inode << ":" << name << "\n";
+                    if (parent_is_ghost) {
+                        //std::cout << indent << " (" << live.inode << ":" << live.name << ")\n";
+                    } else {
+                        std::cout << indent << " " << live.inode << ":" << live.name << "\n";
+                    }
                 }
             }
-        }
 
-        for (const auto& ghost : all_ghosts) {
-            std::string indent(depth, '-');
-            if (ghost.file_type == EXT2_D_DTYPE) {
-                string new_path = current_path.empty() ? ghost.name : current_path + "/" + ghost.name;
-                traverseDirectory(ghost.inode, depth, new_path, ghost.name, true);
-            } else {
-                if(!parent_is_ghost) cout << indent << " (" << ghost.inode << ":" << ghost.name << ")\n";
+            for (; ghost_idx < listing.ghost_end[b]; ghost_idx++) {
+                if (!ghost_ok[ghost_idx]) continue;
+                const GhostEntry& ghost = listing.ghosts[ghost_idx];
+                if (ghost.file_type == EXT2_D_DTYPE) {
+                    traverseDirectory(ghost.inode, depth, joinPath(current_path, ghost.name), string(ghost.name), true);
+                } else {
+                    if(!parent_is_ghost) cout << indent << " (" << ghost.inode << ":" << ghost.name << ")\n";
+                }
             }
         }
     }
-    Info getGhostsandLive(InodeRecord inode){
+    Info getGhostsandLive(const InodeRecord& inode){
         int live_count = 0, ghost_count = 0;
         EntryRecord LiveEntry, CreationEntry, DeletionEntry, OtherGhost;
         bool foundCreation=false, foundDeletion=false, foundOtherGhost=false;
@@ -388,8 +1385,8 @@ private:
             //Creation arama
             int potential_flag=0; EntryRecord potential;
             for (const auto& e : inode.entries) {
-                if(e.is_ghost && readInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
-                else if (e.is_ghost && readInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
+                if(e.is_ghost && parentInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
+                else if (e.is_ghost && parentInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
                     potential_flag++; 
                     potential=e;}
             }
@@ -402,8 +1399,8 @@ private:
             }
             else if(!foundCreation){
                 for(const auto&e : inode.entries){
-                    if((e.is_ghost) && (readInode(e.parent_inode).modification_time==readInode(LiveEntry.parent_inode).modification_time 
-                                || readInode(e.parent_inode).modification_time==inode.inode_data.change_time)) {
+                    if((e.is_ghost) && (parentInode(e.parent_inode).modification_time==parentInode(LiveEntry.parent_inode).modification_time 
+                                || parentInode(e.parent_inode).modification_time==inode.inode_data.change_time)) {
                         foundOtherGhost=true;
                         OtherGhost=e;
                         break;
@@ -421,8 +1418,8 @@ private:
             //Creation arama
             int potential_flag=0; EntryRecord potential;
             for (const auto& e : inode.entries) {
-                if(e.is_ghost && readInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
-                else if (e.is_ghost && readInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
+                if(e.is_ghost && parentInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
+                else if (e.is_ghost && parentInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
                     potential_flag++; 
                     potential=e;}
             }
@@ -437,8 +1434,8 @@ private:
             //hem creation hem deletion ara.
             int potential_flag=0; EntryRecord potential;
             for (const auto& e : inode.entries) {
-                if(readInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
-                else if (readInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
+                if(parentInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
+                else if (parentInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
                     potential_flag++; 
                     potential=e;}
             }
@@ -453,8 +1450,8 @@ private:
             else if(!foundCreation){
                 int potential_flag=0; EntryRecord potential;
                 for (const auto& e : inode.entries) {
-                    if(readInode(e.parent_inode).modification_time == inode.inode_data.deletion_time){foundDeletion=true; DeletionEntry=e; break;}
-                    else if (readInode(e.parent_inode).modification_time > inode.inode_data.deletion_time){ 
+                    if(parentInode(e.parent_inode).modification_time == inode.inode_data.deletion_time){foundDeletion=true; DeletionEntry=e; break;}
+                    else if (parentInode(e.parent_inode).modification_time > inode.inode_data.deletion_time){ 
                         potential_flag++; 
                         potential=e;}
                 }
@@ -473,8 +1470,8 @@ private:
             //creation arama
             int potential_flag_c=0; EntryRecord potential_c;
             for (const auto& e : inode.entries) {
-                if(e.is_ghost && readInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
-                else if (e.is_ghost && readInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
+                if(e.is_ghost && parentInode(e.parent_inode).modification_time == inode.inode_data.access_time){foundCreation=true; CreationEntry=e; break;}
+                else if (e.is_ghost && parentInode(e.parent_inode).access_time < inode.inode_data.access_time){ 
                     potential_flag_c++; 
                     potential_c=e;}
             }
@@ -482,8 +1479,8 @@ private:
             //deletion arama
             int potential_flag=0; EntryRecord potential;
             for (const auto& e : inode.entries) {
-                if(readInode(e.parent_inode).modification_time == inode.inode_data.deletion_time){foundDeletion=true; DeletionEntry=e; break;}
-                else if (readInode(e.parent_inode).modification_time > inode.inode_data.deletion_time){ 
+                if(parentInode(e.parent_inode).modification_time == inode.inode_data.deletion_time){foundDeletion=true; DeletionEntry=e; break;}
+                else if (parentInode(e.parent_inode).modification_time > inode.inode_data.deletion_time){ 
                     potential_flag++; 
                     potential=e;}
                 }
@@ -496,207 +1493,620 @@ private:
     }
 
     void printRecoveredActions() {
-        vector<Action> actions;
-        Info info;
-        for (const auto& [inode, record] : inode_to_info) {
-            info=getGhostsandLive(record);
-            const auto& inode_data = record.inode_data;
+        vector<Action> actions = recoveredActions();
+        emitActions(actions);
+    }
+
+    const vector<Action>& recoveredActions() {
+        if (!actions_collected) {
+            actions_collected = true;
+            for (const auto& [inode, record] : inode_to_info) {
+                collectActions(inode, record, recovered_actions);
+            }
+        }
+        return recovered_actions;
+    }
+
+    // Infers the creation, deletion and move actions of one catalogued inode.
+    void collectActions(uint32_t inode, const InodeRecord& record, vector<Action>& actions) {
+        Info info=getGhostsandLive(record);
+        size_t first = actions.size();
+        collectActions(inode, record, info, actions);
+        // two or more ghosts go through the timestamp-matching branches
+        if (info.ghost_count >= 2) {
+            for (size_t i = first; i < actions.size(); i++) actions[i].heuristic = true;
+        }
+        resolveEndpoints(inode, record, actions, first);
+    }
+
+    // Parent directories are looked up many times per inode during inference.
+    const ext2_inode& parentInode(uint32_t inode_num) {
+        auto it = inference_inodes.find(inode_num);
+        if (it == inference_inodes.end()) it = inference_inodes.emplace(inode_num, readInode(inode_num)).first;
+        return it->second;
+    }
+
+    // Directory mtimes and inode atime/ctime/dtime for the whole image, taken from
+    // the inode tables the first time an endpoint needs resolving.
+    void buildTimeIndex() {
+        if (time_index_built) return;
+        time_index_built = true;
+        if (image_resident) {
+            indexColumns(inode_columns, 0);
+        } else {
+            uint32_t per_block = geometry.inodesPerBlock();
+            uint32_t table_blocks = (super_block.inodes_per_group + per_block - 1) / per_block;
+            InodeColumns columns;
+            for (uint32_t g = 0; g < num_block_groups; g++) {
+                for (uint32_t tb = 0; tb < table_blocks; tb++) {
+                    auto table = fetchBlock(bgd_table[g].inode_table + tb);
+                    if (!table) continue;
+                    uint32_t first = tb * per_block;
+                    uint32_t count = std::min(per_block, super_block.inodes_per_group - first);
+                    columns.resize(count);
+                    columns.decode(table.value().data(), count, geometry.inode_size, 0);
+                    indexColumns(columns, static_cast<size_t>(g) * super_block.inodes_per_group + first);
+                }
+            }
+        }
+        dir_times.seal();
+        inode_times.seal();
+    }
+
+    void indexColumns(const InodeColumns& columns, size_t first_row) {
+        for (size_t r = 0; r < columns.rows(); r++) {
+            if (columns.mode[r] == 0) continue;
+            uint32_t inode_num = static_cast<uint32_t>(first_row + r + 1);
+            bool is_dir = columns.mode[r] & EXT2_I_DTYPE;
+            if (is_dir) dir_times.add(columns.modification_time[r], inode_num);
+            inode_times.add(columns.access_time[r], inode_num);
+            // The kernel stamps a directory's ctime with its mtime on every
+            // dirent change; that stamp is the directory's entry in dir_times,
+            // not another inode changing in the same second.
+            if (!is_dir || columns.change_time[r] != columns.modification_time[r]) {
+                inode_times.add(columns.change_time[r], inode_num);
+            }
+            inode_times.add(columns.deletion_time[r], inode_num);
+        }
+    }
+
+    // The directory last modified at time, provided nothing but this inode was
+    // created, changed or deleted in that second; 0 when that is not certain.
+    uint32_t directoryChangedBy(uint32_t inode_num, uint32_t time, uint32_t exclude_dir) const {
+        if (time == 0 || !inode_times.onlyInode(time, inode_num)) return 0;
+        return dir_times.soleInode(time, inode_num, exclude_dir);
+    }
+
+    // Path of the inode's entry in dir; failing that, dir's path plus the name
+    // the inode had everywhere it was seen.
+    string pathIn(const InodeRecord& record, uint32_t dir) {
+        for (const auto& e : record.entries) {
+            if (e.parent_inode == dir) return e.full_path;
+        }
+        if (record.entries.empty()) return "";
+        for (const auto& e : record.entries) {
+            if (e.name != record.entries[0].name) return "";
+        }
+        string dir_path = directoryPath(dir, 0, resolved_paths);
+        if (dir_path == "?") return "";
+        return "/" + joinPath(dir_path, record.entries[0].name);
+    }
+
+    // Fills `?` endpoints and timestamps left by the matching above, using
+    // binary-search joins on the time indexes. Only unambiguous matches are
+    // taken, and every action touched is marked heuristic.
+    void resolveEndpoints(uint32_t inode, const InodeRecord& record, vector<Action>& actions, size_t first) {
+        bool unresolved = false;
+        for (size_t i = first; i < actions.size() && !unresolved; i++) {
+            for (uint32_t d : actions[i].affected_dirs) unresolved = unresolved || d == 0;
+            unresolved = unresolved || actions[i].timestamp == 0;
+        }
+        if (!unresolved) return;
+        buildTimeIndex();
+
+        bool dropped = false;
+        for (size_t i = first; i < actions.size(); i++) {
+            Action& a = actions[i];
+            if (a.action != "mv") {
+                // creation at atime, deletion at dtime: the parent was modified then
+                if (a.affected_dirs[0] != 0) continue;
+                uint32_t dir = directoryChangedBy(inode, a.timestamp, 0);
+                if (dir == 0) continue;
+                a.affected_dirs[0] = dir;
+                a.args[0] = pathIn(record, dir);
+                a.heuristic = true;
+                continue;
+            }
+
+            uint32_t& src = a.affected_dirs[0];
+            uint32_t& dst = a.affected_dirs[1];
+            if (a.timestamp == 0 && src != 0) {
+                // a move out of src is the last thing that happened there if src's
+                // mtime is this inode's ctime and nothing else changed in that second
+                uint32_t t = parentInode(src).modification_time;
+                if (t != record.inode_data.change_time || !inode_times.onlyInode(t, inode)) continue;
+                size_t same = actions.size();
+                for (size_t j = first; j < actions.size(); j++) {
+                    if (j != i && actions[j].action == "mv" && actions[j].timestamp == t) same = j;
+                }
+                if (same != actions.size()) {
+                    // the move at ctime already exists with an unknown source: this is it
+                    Action& known = actions[same];
+                    if (known.affected_dirs[0] != 0) continue;
+                    known.affected_dirs[0] = src;
+                    known.args[0] = a.args[0];
+                    known.heuristic = true;
+                    a.action.clear();
+                    dropped = true;
+                    continue;
+                }
+                a.timestamp = t;
+                a.heuristic = true;
+                if (dst == 0) {
+                    dst = dir_times.soleInode(t, inode, src);
+                    if (dst != 0) a.args[1] = pathIn(record, dst);
+                }
+                continue;
+            }
+            if (a.timestamp != 0 && (src == 0) != (dst == 0)) {
+                uint32_t known_dir = src != 0 ? src : dst;
+                uint32_t dir = directoryChangedBy(inode, a.timestamp, known_dir);
+                if (dir == 0) continue;
+                (src == 0 ? src : dst) = dir;
+                a.args[src == dir ? 0 : 1] = pathIn(record, dir);
+                a.heuristic = true;
+            }
+        }
+        if (dropped) {
+            actions.erase(std::remove_if(actions.begin() + first, actions.end(),
+                                         [](const Action& a) { return a.action.empty(); }),
+                          actions.end());
+        }
+    }
+
+    void collectActions(uint32_t inode, const InodeRecord& record, const Info& info, vector<Action>& actions) {
+        const auto& inode_data = record.inode_data;
+        Action action;
+        action.timestamp = inode_data.access_time;
+        action.action = (inode_data.mode & EXT2_I_DTYPE) ? "mkdir" : "touch";
+        action.affected_inodes = { inode };
+        if(info.foundCreation){
+            action.args={info.CreationEntry.full_path};
+            action.affected_dirs={info.CreationEntry.parent_inode};
+        }
+        else{
+            action.args = {""};
+            action.affected_dirs = {0};
+        }
+        actions.push_back(action);
+        //-----------------mkdir/touch yapildi------------------------//
+
+        if(info.ghost_count==0) return;
+
+        if(inode_data.deletion_time!=0){
             Action action;
-            action.timestamp = inode_data.access_time;
-            action.action = (inode_data.mode & EXT2_I_DTYPE) ? "mkdir" : "touch";
-            action.affected_inodes = { inode };
-            if(info.foundCreation){
-                action.args={info.CreationEntry.full_path};
-                action.affected_dirs={info.CreationEntry.parent_inode};
+            action.timestamp=inode_data.deletion_time;
+            action.action=(inode_data.mode & EXT2_I_DTYPE) ? "rmdir" : "rm";
+            action.affected_inodes={inode};
+            if(info.foundDeletion){
+                action.args={info.DeletionEntry.full_path};
+                action.affected_dirs={info.DeletionEntry.parent_inode};
             }
             else{
                 action.args = {""};
                 action.affected_dirs = {0};
             }
             actions.push_back(action);
-            //-----------------mkdir/touch yapildi------------------------//
-
-            if(info.ghost_count==0) continue;
 
-            if(inode_data.deletion_time!=0){
-                Action action;
-                action.timestamp=inode_data.deletion_time;
-                action.action=(inode_data.mode & EXT2_I_DTYPE) ? "rmdir" : "rm";
-                action.affected_inodes={inode};
-                if(info.foundDeletion){
-                    action.args={info.DeletionEntry.full_path};
-                    action.affected_dirs={info.DeletionEntry.parent_inode};
+        //----------------rm/rmdir yapildi--------------------------//
+                         
+        Action actmove;
+        actmove.action="mv";
+        actmove.affected_inodes={inode};
+        actmove.timestamp=0;
+        if(info.ghost_count==2 && info.foundCreation && info.foundDeletion ){
+            actmove.args={info.CreationEntry.full_path, info.DeletionEntry.full_path};
+            actmove.affected_dirs={info.CreationEntry.parent_inode, info.DeletionEntry.parent_inode};
+            actions.push_back(actmove); 
+        }
+        else if(info.ghost_count>1){
+            //ghost sayısı kadar dön, sadece nereden cıktıklarının movelarını yazabilirsin, deletion entryi pass geç.
+            if(info.foundDeletion){
+                actmove.args={"?",info.DeletionEntry.full_path};
+                actmove.affected_dirs={0 , info.DeletionEntry.parent_inode};
+                actions.push_back(actmove);
+                
+                for (const auto& e : record.entries) {
+                    if(e.is_ghost && !(e==info.DeletionEntry)){
+                        actmove.args={e.full_path,"?"};
+                        actmove.affected_dirs={e.parent_inode,0};
+                        actions.push_back(actmove);
+                    }
                 }
-                else{
-                    action.args = {""};
-                    action.affected_dirs = {0};
+            }
+            else{
+                for (const auto& e : record.entries) { //burada fazladan bir move bastırma olasılığın cok yüksek. tradeoff.
+                    if(e.is_ghost && parentInode(e.parent_inode).modification_time!=inode_data.deletion_time){
+                        actmove.args={e.full_path,"?"};
+                        actmove.affected_dirs={e.parent_inode,0};
+                        actions.push_back(actmove);
+                    }
                 }
-                actions.push_back(action);
+            }
+        }
+
+        }
+ 
 
-            //----------------rm/rmdir yapildi--------------------------//
-                             
+        else{ //deletion_time==0  // 1ghost-1live, 3 ghost-1live gibi. çünkü sadece live olanlari continueladın. 
             Action actmove;
             actmove.action="mv";
             actmove.affected_inodes={inode};
-            actmove.timestamp=0;
-            if(info.ghost_count==2 && info.foundCreation && info.foundDeletion ){
-                actmove.args={info.CreationEntry.full_path, info.DeletionEntry.full_path};
-                actmove.affected_dirs={info.CreationEntry.parent_inode, info.DeletionEntry.parent_inode};
-                actions.push_back(actmove); 
-            }
-            else if(info.ghost_count>1){
-                //ghost sayısı kadar dön, sadece nereden cıktıklarının movelarını yazabilirsin, deletion entryi pass geç.
-                if(info.foundDeletion){
-                    actmove.args={"?",info.DeletionEntry.full_path};
-                    actmove.affected_dirs={0 , info.DeletionEntry.parent_inode};
-                    actions.push_back(actmove);
-                    
-                    for (const auto& e : record.entries) {
-                        if(e.is_ghost && !(e==info.DeletionEntry)){
-                            actmove.args={e.full_path,"?"};
-                            actmove.affected_dirs={e.parent_inode,0};
-                            actions.push_back(actmove);
-                        }
+
+            if(info.ghost_count==1 && info.live_count==0){
+                // still allocated but its current name was never reached (a ghost pointing
+                // at an ancestor, or a move out of the --root subtree)
+                actmove.timestamp=0;
+                actmove.affected_dirs={record.entries[0].parent_inode, 0};
+                actmove.args={record.entries[0].full_path, "?"};
+                actions.push_back(actmove);
+            }
+            else if(info.ghost_count==1){
+                if(inode_data.change_time!=inode_data.modification_time) actmove.timestamp=inode_data.change_time;
+                else {actmove.timestamp=0;}  
+                actmove.affected_dirs = { record.entries[0].parent_inode , record.entries[1].parent_inode};
+                if(record.entries[0].is_ghost){ 
+                    actmove.args = {record.entries[0].full_path, record.entries[1].full_path};
                     }
-                }
                 else{
-                    for (const auto& e : record.entries) { //burada fazladan bir move bastırma olasılığın cok yüksek. tradeoff.
-                        if(e.is_ghost && readInode(e.parent_inode).modification_time!=inode_data.deletion_time){
-                            actmove.args={e.full_path,"?"};
-                            actmove.affected_dirs={e.parent_inode,0};
-                            actions.push_back(actmove);
-                        }
+                    actmove.args = {record.entries[1].full_path, record.entries[0].full_path};
                     }
-                }
-            }
 
+                actions.push_back(actmove);
             }
- 
-
-            else{ //deletion_time==0  // 1ghost-1live, 3 ghost-1live gibi. çünkü sadece live olanlari continueladın. 
-                Action actmove;
-                actmove.action="mv";
-                actmove.affected_inodes={inode};
+            else if(info.ghost_count==2 && info.foundCreation && info.foundOtherGhost){
+                actmove.affected_dirs={info.CreationEntry.parent_inode, info.OtherGhost.parent_inode};
+                actmove.timestamp=0;
+                actmove.args={info.CreationEntry.full_path,info.OtherGhost.full_path};
+                actions.push_back(actmove);
 
-                if(info.ghost_count==1){
-                    if(inode_data.change_time!=inode_data.modification_time) actmove.timestamp=inode_data.change_time;
-                    else {actmove.timestamp=0;}  
-                    actmove.affected_dirs = { record.entries[0].parent_inode , record.entries[1].parent_inode};
-                    if(record.entries[0].is_ghost){ 
-                        actmove.args = {record.entries[0].full_path, record.entries[1].full_path};
+                actmove.affected_dirs={info.OtherGhost.parent_inode,info.LiveEntry.parent_inode};
+                actmove.args={info.OtherGhost.full_path,info.LiveEntry.full_path};
+                if(parentInode(info.OtherGhost.parent_inode).modification_time==parentInode(info.LiveEntry.parent_inode).modification_time 
+                        || parentInode(info.OtherGhost.parent_inode).modification_time==inode_data.change_time)
+                    actmove.timestamp={parentInode(info.OtherGhost.parent_inode).modification_time};
+                else if(inode_data.change_time!=inode_data.modification_time) {
+                    actmove.timestamp=inode_data.change_time;}
+                actions.push_back(actmove);
+            }
+            else{
+                bool matchedwithLive=false;
+                for (const auto& e : record.entries) {
+                    if(!e.is_ghost) continue;
+                    if(parentInode(e.parent_inode).modification_time==parentInode(info.LiveEntry.parent_inode).modification_time 
+                        || parentInode(e.parent_inode).modification_time==inode_data.change_time){
+                        matchedwithLive=true;
+                        actmove.affected_dirs={e.parent_inode,info.LiveEntry.parent_inode};
+                        actmove.args={e.full_path,info.LiveEntry.full_path};
+                        actmove.timestamp=parentInode(e.parent_inode).modification_time;
                         }
                     else{
-                        actmove.args = {record.entries[1].full_path, record.entries[0].full_path};
-                        }
-
-                    actions.push_back(actmove);
-                }
-                else if(info.ghost_count==2 && info.foundCreation && info.foundOtherGhost){
-                    actmove.affected_dirs={info.CreationEntry.parent_inode, info.OtherGhost.parent_inode};
+                    actmove.affected_dirs={e.parent_inode, 0};
+                    actmove.args={e.full_path, "?"}; 
                     actmove.timestamp=0;
-                    actmove.args={info.CreationEntry.full_path,info.OtherGhost.full_path};
+                    }
                     actions.push_back(actmove);
-
-                    actmove.affected_dirs={info.OtherGhost.parent_inode,info.LiveEntry.parent_inode};
-                    actmove.args={info.OtherGhost.full_path,info.LiveEntry.full_path};
-                    if(readInode(info.OtherGhost.parent_inode).modification_time==readInode(info.LiveEntry.parent_inode).modification_time 
-                            || readInode(info.OtherGhost.parent_inode).modification_time==inode_data.change_time)
-                        actmove.timestamp={readInode(info.OtherGhost.parent_inode).modification_time};
-                    else if(inode_data.change_time!=inode_data.modification_time) {
-                        actmove.timestamp=inode_data.change_time;}
+                }
+                if(!matchedwithLive){
+                    actmove.affected_dirs={0,info.LiveEntry.parent_inode};
+                    actmove.args={"?",info.LiveEntry.full_path};
+                    if(inode_data.change_time!=inode_data.modification_time) actmove.timestamp=inode_data.change_time;
+                    else actmove.timestamp=0;
                     actions.push_back(actmove);
                 }
-                else{
-                    bool matchedwithLive=false;
-                    for (const auto& e : record.entries) {
-                        if(!e.is_ghost) continue;
-                        if(readInode(e.parent_inode).modification_time==readInode(info.LiveEntry.parent_inode).modification_time 
-                            || readInode(e.parent_inode).modification_time==inode_data.change_time){
-                            matchedwithLive=true;
-                            actmove.affected_dirs={e.parent_inode,info.LiveEntry.parent_inode};
-                            actmove.args={e.full_path,info.LiveEntry.full_path};
-                            actmove.timestamp=readInode(e.parent_inode).modification_time;
-                            }
-                        else{
-                        actmove.affected_dirs={e.parent_inode, 0};
-                        actmove.args={e.full_path, "?"}; 
-                        actmove.timestamp=0;
-                        }
-                        actions.push_back(actmove);
-                    }
-                    if(!matchedwithLive){
-                        actmove.affected_dirs={0,info.LiveEntry.parent_inode};
-                        actmove.args={"?",info.LiveEntry.full_path};
-                        if(inode_data.change_time!=inode_data.modification_time) actmove.timestamp=inode_data.change_time;
-                        else actmove.timestamp=0;
-                        actions.push_back(actmove);
-                    }
-                    
-                }       
-            }
+                
+            }       
         }
-    
-        std::sort(actions.begin(), actions.end(), [](const Action& a, const Action& b) {
-            return a.timestamp < b.timestamp;
-        });
+    }
 
-        for (const auto& act : actions) {
-            printAction(act);
+    void emitActions(vector<Action>& actions) {
+        if (windowed) {
+            // events with an unknown time (0) of inodes that survived pruning stay
+            actions.erase(std::remove_if(actions.begin(), actions.end(), [this](const Action& a) {
+                return a.timestamp != 0 && (a.timestamp < window_since || a.timestamp > window_until);
+            }), actions.end());
         }
-    }
+        if (track_intact) annotateIntact(actions);
 
-        void printAction(Action action) const{
-            if(action.timestamp==0){cout << "? " <<  action.action << " [";}
-            else cout << action.timestamp << " " << action.action << " [";
-            for (size_t i = 0; i < action.args.size(); ++i) {
-                if (i) std::cout << " ";
-                if(action.args[i]=="") cout<<"?";
-                else cout << action.args[i];
-            }
-            std::cout << "] [";
-            for (size_t i = 0; i < action.affected_dirs.size(); ++i) {
-                if (i) std::cout << " ";
-                if(action.affected_dirs[i]==0) cout<<"?";
-                else std::cout << action.affected_dirs[i];
-            }
-            std::cout << "] [";
-            for (size_t i = 0; i < action.affected_inodes.size(); ++i) {
-                if (i) std::cout << " ";
-                if(action.affected_inodes[i]==0) cout<<"?";
-                else std::cout << action.affected_inodes[i];
-            }
-            std::cout << "]\n";
+        std::unique_ptr<HistorySink> sink;
+        switch (history_format) {
+            case HistoryFormat::Ndjson: sink = std::make_unique<NdjsonHistorySink>(cout); break;
+            case HistoryFormat::Binary: sink = std::make_unique<BinaryHistorySink>(cout); break;
+            default: sink = std::make_unique<TextHistorySink>(cout); break;
+        }
+        for (uint32_t k : chronologicalOrder(actions)) {
+            sink->write(actions[k]);
+        }
     }
+};   
 
 
 
-};   
+// Change report between two images of one volume. Both are catalogued a group
+// at a time, each image on its own thread, with the next group read while the
+// current one is merge-joined.
+void compareImages(Ext2FileSystem& older, Ext2FileSystem& newer, std::ostream& out) {
+    if (older.inodesPerGroup() != newer.inodesPerGroup()) {
+        throw std::runtime_error("Images have different inodes per group; not the same volume");
+    }
+    uint32_t groups = std::max(older.groupCount(), newer.groupCount());
+    auto catalog = [](Ext2FileSystem* fs, uint32_t group) {
+        if (group < fs->groupCount()) return fs->catalogGroup(group);
+        GroupCatalog absent;
+        absent.first_inode = group * fs->inodesPerGroup() + 1;
+        return absent;
+    };
+    auto launch = [&](uint32_t group) {
+        return std::make_pair(std::async(std::launch::async, catalog, &older, group),
+                              std::async(std::launch::async, catalog, &newer, group));
+    };
+    if (groups == 0) return;
+    auto pending = launch(0);
+    for (uint32_t g = 0; g < groups; g++) {
+        GroupCatalog a = pending.first.get();
+        GroupCatalog b = pending.second.get();
+        if (g + 1 < groups) pending = launch(g + 1);
+        compareGroups(a, b, out);
+    }
+}
 
+// For each inode reachable through the path, every place it was seen.
+void printQuery(const DirentIndex& index, const string& path) {
+    cout << "query " << path << "\n";
+    std::set<uint32_t> inodes;
+    for (uint32_t idx : index.resolve(path)) {
+        inodes.insert(index.at(idx).inode);
+    }
+    for (uint32_t inode : inodes) {
+        for (uint32_t idx : index.lookupInode(inode)) {
+            const DirentRecord& r = index.at(idx);
+            cout << r.inode << (r.is_ghost ? " ghost " : " live ") << r.full_path
+                 << " [" << r.parent_inode << "]\n";
+        }
+    }
+}
 
+void printUsage() {
+    std::cerr << "Usage: ./histext2fs <image> <state_output> <history_output> [options]\n"
+              << "  --sequential         read the image once, front to back\n"
+              << "  --progress           report scan progress on stderr\n"
+              << "  --direct             bypass the page cache (O_DIRECT; default for block devices)\n"
+              << "  --query PATH         list every live/ghost location of PATH (or bare name)\n"
+              << "  --index-out FILE     save the dirent index after recovery\n"
+              << "  --index-in FILE      answer --query from a saved index without scanning\n"
+              << "  --root PATH|INODE    scope the state tree and history to one subtree\n"
+              << "  --since T, --until T limit the history to a unix-time window\n"
+              << "  --at T               write the tree as it stood at unix time T instead (repeatable)\n"
+              << "  --diff T1 T2         write the paths added, removed and moved between T1 and T2 instead\n"
+              << "  --history-format F   text (default), ndjson or binary\n"
+              << "  --export-arrow DIR   write the inode/dirent catalog as Arrow IPC files\n"
+              << "  --manifest FILE      write an xxh3 manifest of every block read\n"
+              << "  --extract DIR        write the recoverable contents of deleted regular files to DIR\n"
+              << "  --extract-all DIR    same for every regular file, live or deleted\n"
+              << "  --intact             note on rm/rmdir how many of the data blocks are still unclaimed\n"
+              << "  --compare OLDER      write a change report against an older image of the volume\n"
+              << "                       to the state output (no history is written)\n"
+              << "  --inode N[,M...]     write only these inodes' history (uses --index-in if given)\n";
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: ./histext2fs <image> <state_output> <history_output>\n";
+    if (argc < 4) {
+        printUsage();
         return 1;
     }
     const string image_path = argv[1];
     const string state_output = argv[2];
     const string history_output = argv[3];
+    bool sequential = false;
+    bool show_progress = false;
+    bool direct_io = false;
+    vector<string> queries;
+    string index_out, index_in;
+    vector<uint32_t> inode_targets;
+    vector<uint32_t> at_times;
+    vector<std::pair<uint32_t, uint32_t>> diffs;
+    string scope;
+    string arrow_dir;
+    string manifest;
+    string compare_image;
+    string extract_dir;
+    bool extract_all = false;
+    bool intact = false;
+    bool windowed = false;
+    uint32_t since = 0, until = UINT32_MAX;
+    HistoryFormat history_format = HistoryFormat::Text;
+    auto number = [&](const string& option, const string& text) {
+        uint32_t value;
+        if (!parseUint32(text, value)) {
+            std::cerr << "Invalid value for " << option << ": " << text << "\n";
+            printUsage();
+            std::exit(1);
+        }
+        return value;
+    };
+    for (int i = 4; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--sequential") {
+            sequential = true;
+        } else if (arg == "--progress") {
+            show_progress = true;
+        } else if (arg == "--direct") {
+            direct_io = true;
+        } else if (arg == "--intact") {
+            intact = true;
+        } else if (arg == "--query" && has_value) {
+            queries.push_back(argv[++i]);
+        } else if (arg == "--index-out" && has_value) {
+            index_out = argv[++i];
+        } else if (arg == "--index-in" && has_value) {
+            index_in = argv[++i];
+        } else if (arg == "--since" && has_value) {
+            since = number(arg, argv[++i]);
+            windowed = true;
+        } else if (arg == "--until" && has_value) {
+            until = number(arg, argv[++i]);
+            windowed = true;
+        } else if (arg == "--at" && has_value) {
+            at_times.push_back(number(arg, argv[++i]));
+        } else if (arg == "--diff" && i + 2 < argc) {
+            uint32_t t1 = number(arg, argv[++i]);
+            diffs.push_back({t1, number(arg, argv[++i])});
+        } else if (arg == "--history-format" && has_value) {
+            string format = argv[++i];
+            if (format == "text") history_format = HistoryFormat::Text;
+            else if (format == "ndjson") history_format = HistoryFormat::Ndjson;
+            else if (format == "binary") history_format = HistoryFormat::Binary;
+            else {
+                std::cerr << "Unknown history format: " << format << "\n";
+                return 1;
+            }
+        } else if (arg == "--export-arrow" && has_value) {
+            arrow_dir = argv[++i];
+        } else if (arg == "--manifest" && has_value) {
+            manifest = argv[++i];
+        } else if ((arg == "--extract" || arg == "--extract-all") && has_value) {
+            extract_dir = argv[++i];
+            extract_all = arg == "--extract-all";
+        } else if (arg == "--compare" && has_value) {
+            compare_image = argv[++i];
+        } else if (arg == "--root" && has_value) {
+            scope = argv[++i];
+        } else if (arg == "--inode" && has_value) {
+            std::stringstream list(argv[++i]);
+            string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) inode_targets.push_back(number(arg, item));
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (!inode_targets.empty()) {
+        std::unique_ptr<DirentIndex> index;
+        if (!index_in.empty()) index = std::make_unique<DirentIndex>(DirentIndex::load(index_in));
+        Ext2FileSystem fs(image_path, direct_io);
+        if (windowed) fs.setTimeWindow(since, until);
+        fs.setHistoryFormat(history_format);
+        if (intact) fs.enableIntactTracking();
+        if (!manifest.empty()) fs.enableReadManifest();
+        std::ofstream history_out(history_output, history_format == HistoryFormat::Binary
+                                                      ? std::ios::out | std::ios::binary : std::ios::out);
+        std::streambuf* coutbuf = std::cout.rdbuf();
+        std::cout.rdbuf(history_out.rdbuf());
+        fs.recoverInodes(inode_targets, index.get());
+        std::cout.rdbuf(coutbuf);
+        if (!manifest.empty()) fs.writeReadManifest(manifest, image_path);
+        return 0;
+    }
 
-    Ext2FileSystem fs(image_path);
+    if (!compare_image.empty()) {
+        Ext2FileSystem older(compare_image, direct_io);
+        Ext2FileSystem newer(image_path, direct_io);
+        std::ofstream state_out(state_output);
+        compareImages(older, newer, state_out);
+        return 0;
+    }
+
+    if (!index_in.empty()) {
+        DirentIndex index = DirentIndex::load(index_in);
+        for (const auto& q : queries) printQuery(index, q);
+        return 0;
+    }
+
+    Ext2FileSystem fs(image_path, direct_io);
+    std::unique_ptr<ProgressReporter> reporter;
+    if (show_progress) {
+        reporter = std::make_unique<ProgressReporter>(fs.scanProgress(), fs.blockSize(),
+                                                      fs.blockCount(), fs.groupCount(), fs.directoryCount());
+    }
+    if (!manifest.empty()) {
+        fs.enableReadManifest();
+    }
+    if (sequential) {
+        fs.loadSequential();
+    }
+    if (!scope.empty()) {
+        try {
+            fs.setScope(scope);
+        } catch (const std::exception& e) {
+            std::cerr << "Invalid --root " << scope << ": " << e.what() << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+    if (windowed) {
+        fs.setTimeWindow(since, until);
+    }
+    fs.setHistoryFormat(history_format);
+    if (intact) {
+        fs.enableIntactTracking();
+    }
 
     // Redirect state output
     std::ofstream state_out(state_output);
     std::streambuf* coutbuf = std::cout.rdbuf(); // backup
-    std::cout.rdbuf(state_out.rdbuf());
+    // with --at/--diff the walk still runs to catalog entries, but its tree is discarded
+    bool replayed = !at_times.empty() || !diffs.empty();
+    std::cout.rdbuf(replayed ? nullptr : state_out.rdbuf());
     fs.displayDirectoryTree();
     std::cout.rdbuf(coutbuf); // restore
+    if (!at_times.empty()) {
+        vector<string> trees = fs.treesAt(at_times);
+        for (size_t t = 0; t < trees.size(); t++) {
+            if (trees.size() > 1 || !diffs.empty()) state_out << "@ " << at_times[t] << "\n";
+            state_out << trees[t];
+        }
+    }
+    for (const auto& [t1, t2] : diffs) {
+        if (diffs.size() > 1 || !at_times.empty()) state_out << "@ " << t1 << " " << t2 << "\n";
+        state_out << fs.diffBetween(t1, t2);
+    }
 
     // Redirect history output
-    std::ofstream history_out(history_output);
+    std::ofstream history_out(history_output, history_format == HistoryFormat::Binary
+                                                  ? std::ios::out | std::ios::binary : std::ios::out);
     std::cout.rdbuf(history_out.rdbuf());
     fs.recovery();
     std::cout.rdbuf(coutbuf); // restore again
+    uint64_t misses = fs.scanProgress().resident_misses.load();
+    if (sequential && misses > 0) {
+        std::cerr << "warning: " << misses << " blocks were not resident and were read randomly\n";
+    }
+
+    if (!arrow_dir.empty()) {
+        fs.exportArrow(arrow_dir);
+    }
+    int status = 0;
+    if (!extract_dir.empty()) {
+        auto [requested, written] = fs.extractFiles(extract_dir, extract_all, image_path);
+        if (written < requested) {
+            std::cerr << "Extracted " << written << " of " << requested << " files to " << extract_dir << "\n";
+            status = 1;
+        }
+    }
+    if (!manifest.empty()) {
+        fs.writeReadManifest(manifest, image_path);
+    }
+
+    if (!queries.empty() || !index_out.empty()) {
+        DirentIndex index = fs.buildIndex();
+        if (!index_out.empty()) index.save(index_out);
+        for (const auto& q : queries) printQuery(index, q);
+    }
 
-    return 0;
+    return status;
 }